@@ -0,0 +1,263 @@
+"""Background computation of per-state analytics.
+
+Plans, eligibility lists and credit gaps run in a process pool, off the
+Dash request thread, and are cached per program, completion bitmask and
+credit cap; callers poll with result(). What-if batches (whatif.py) run in
+a second pool, with batch().
+"""
+from collections import OrderedDict
+from concurrent.futures import ProcessPoolExecutor
+from concurrent.futures.process import BrokenProcessPool
+import math
+import multiprocessing
+import os
+import threading
+import time
+import traceback
+
+from eligibility import CompletionState
+from planner import Planner
+from reachability import descendant_counts
+import whatif
+
+# Seconds a failed job is answered with its error before it is retried
+RETRY_SECONDS = 30
+
+_programs = {}
+_workers = {}
+_registry = None
+
+
+def _init_worker(programs):
+    """Remember where each program's catalog is, in a worker process."""
+    global _registry
+    from catalogs import CourseRegistry
+
+    _programs.update(programs)
+    _registry = CourseRegistry()
+
+
+def _load(program_id, version):
+    # A job for a new catalog version (after a hot reload) loads it again;
+    # the reloading process has rewritten the snapshot by then
+    loaded = _workers.get(program_id)
+    if loaded is None or loaded[0] != version:
+        import main
+
+        catalog_files, snapshot_path = _programs[program_id]
+        courses, group_colors, group_credits = _registry.share(
+            *main.load_program_catalog(catalog_files, snapshot_path)
+        )
+        loaded = _workers[program_id] = (version, Analytics(main.GraphModel(courses, group_colors), group_credits))
+    return loaded[1]
+
+
+def _run_job(program_id, version, completed_hex, credit_cap):
+    return _load(program_id, version).compute(completed_hex, credit_cap)
+
+
+def _run_batch(program_id, version, completed, courses):
+    analytics = _load(program_id, version)
+    return whatif.evaluate(analytics.model, analytics.group_credits, completed, courses)
+
+
+class Analytics:
+    """The analytics for one catalog, computed in the calling thread."""
+
+    def __init__(self, model, group_credits):
+        self.model = model
+        self.group_credits = group_credits
+        self.planner = Planner(model, group_credits)
+
+    def compute(self, completed_hex, credit_cap):
+        """Plan, credit gaps and eligible courses for one completion bitmask."""
+        model = self.model
+        state = CompletionState(model, int(completed_hex, 16))
+        plan = self.planner.plan(state, credit_cap)
+        return {
+            "terms": plan.terms,
+            "critical_path": plan.critical_path,
+            "shortfall": plan.shortfall,
+            "gaps": {
+                group: max(0, needed - state.group_completed_credits.get(group, 0))
+                for group, needed in self.group_credits.items()
+            },
+            "eligible": [model.nodes[i] for i in self.eligible(state)],
+        }
+
+    def eligible(self, state):
+        """Courses that can be taken next, those unlocking the most remaining courses first."""
+        size = len(self.model.nodes)
+        remaining = ((1 << size) - 1) & ~state.completed
+        courses = [i for i in range(size) if state.is_eligible(i) and not state.is_completed(i)]
+        unlocks = descendant_counts(self.model, remaining, courses)
+        courses.sort(key=lambda i: -unlocks[i])
+        return courses
+
+
+class AnalyticsWorker:
+    """Runs Analytics.compute in a process pool and caches the results.
+
+    programs maps a program id to its (catalog_files, snapshot_path), with
+    no files for a program read from a data source, and analytics maps it to
+    its (catalog version, Analytics); with max_workers=0 the jobs run inline
+    through the latter, which is handy for debugging. batch_workers sizes
+    the batch pool (default: one process per CPU). A failed job gives an
+    error result for RETRY_SECONDS; a pool whose process died is replaced.
+    """
+
+    def __init__(self, programs, analytics, max_workers=1, maxsize=1024, batch_workers=None):
+        self.programs = programs
+        self.analytics = analytics
+        self.max_workers = max_workers
+        self.batch_workers = (os.cpu_count() or 1) if batch_workers is None else batch_workers
+        self.maxsize = maxsize
+        self._executors = {}  # "plans" or "batches": (pid, ProcessPoolExecutor)
+        self._lock = threading.Lock()
+        self._results = OrderedDict()
+        self._failures = OrderedDict()
+        self._pending = {}
+
+    def result(self, program_id, completed_hex, credit_cap):
+        """The cached result for a state, or None after scheduling its computation.
+
+        A job that failed less than RETRY_SECONDS ago gives {"error": message}.
+        """
+        submitted = None
+        with self._lock:
+            version, analytics = self.analytics[program_id]
+            key = (program_id, version, completed_hex, credit_cap)
+            if key in self._results:
+                self._results.move_to_end(key)
+                return self._results[key]
+            failure = self._failures.get(key)
+            if failure is not None:
+                failed_at, message = failure
+                if time.monotonic() - failed_at < RETRY_SECONDS:
+                    return {"error": message}
+                del self._failures[key]
+            if self.max_workers <= 0:
+                try:
+                    return self._store(key, analytics.compute(completed_hex, credit_cap))
+                except Exception as error:
+                    return self._fail(key, error)
+            if key not in self._pending:
+                pool = self._pool()
+                try:
+                    future = pool.submit(_run_job, *key)
+                except BrokenProcessPool:
+                    # A worker process died since the last job
+                    self._drop_pool(pool)
+                    pool = self._pool()
+                    future = pool.submit(_run_job, *key)
+                self._pending[key] = future
+                submitted = pool, future
+        if submitted is not None:
+            # Outside the lock: a future that is already done runs the
+            # callback right here, and _finish takes the lock
+            pool, future = submitted
+            future.add_done_callback(lambda done: self._finish(key, pool, done))
+        return None
+
+    def batch(self, program_id, completed, courses=None):
+        """(catalog version, whatif.evaluate rows) for a list of completion bitmasks.
+
+        Blocks until done. Batches of more than whatif.CHUNK_ROWS rows are
+        split into about one chunk per batch worker.
+        """
+        with self._lock:
+            version, analytics = self.analytics[program_id]
+            inline = self.max_workers <= 0 or self.batch_workers <= 0 or len(completed) <= whatif.CHUNK_ROWS
+            pool = None if inline else self._pool("batches")
+        if inline:
+            return version, whatif.evaluate(analytics.model, analytics.group_credits, completed, courses)
+        chunk = max(whatif.CHUNK_ROWS, math.ceil(len(completed) / self.batch_workers))
+        try:
+            return version, self._run_chunks(pool, program_id, version, completed, courses, chunk)
+        except BrokenProcessPool:
+            # Once more on a fresh pool, in case a worker died before this batch
+            with self._lock:
+                self._drop_pool(pool)
+                pool = self._pool("batches")
+            return version, self._run_chunks(pool, program_id, version, completed, courses, chunk)
+
+    def _run_chunks(self, pool, program_id, version, completed, courses, chunk):
+        futures = [
+            pool.submit(_run_batch, program_id, version, completed[start:start + chunk], courses)
+            for start in range(0, len(completed), chunk)
+        ]
+        rows = []
+        for future in futures:
+            rows.extend(future.result())
+        return rows
+
+    def _pool(self, kind="plans"):
+        pid, executor = self._executors.get(kind, (None, None))
+        if executor is None or pid != os.getpid():
+            workers = self.batch_workers if kind == "batches" else self.max_workers
+            # Forked from a threaded server worker, a child could inherit locks
+            # held by other threads; forkserver children start clean
+            executor = ProcessPoolExecutor(
+                workers, mp_context=multiprocessing.get_context("forkserver"), initializer=_init_worker,
+                initargs=(self.programs,)
+            )
+            self._executors[kind] = (os.getpid(), executor)
+            if kind == "plans":
+                self._pending.clear()
+        return executor
+
+    def _drop_pool(self, broken):
+        """Forget a pool a worker process died in, so _pool starts a new one; the lock is held."""
+        for kind, (_, executor) in list(self._executors.items()):
+            if executor is broken:
+                print(f"An analytics worker process died; the {kind} pool is replaced")
+                broken.shutdown(wait=False, cancel_futures=True)
+                del self._executors[kind]
+
+    def precompute(self, program_id, completed_hex, credit_cap):
+        """Schedule a state ahead of time, e.g. the default state at startup."""
+        self.result(program_id, completed_hex, credit_cap)
+
+    def replace(self, program_id, version, model, group_credits):
+        """Switch a program to a reloaded catalog, dropping only its cached results."""
+        with self._lock:
+            self.analytics[program_id] = (version, Analytics(model, group_credits))
+            for cache in (self._results, self._failures):
+                for key in [key for key in cache if key[0] == program_id]:
+                    del cache[key]
+
+    def _finish(self, key, pool, future):
+        with self._lock:
+            if self._pending.get(key) is future:
+                del self._pending[key]
+            program_id, version = key[:2]
+            if future.cancelled() or self.analytics[program_id][0] != version:
+                return
+            error = future.exception()
+            if error is None:
+                self._store(key, future.result())
+                return
+            if isinstance(error, BrokenProcessPool):
+                self._drop_pool(pool)
+            self._fail(key, error)
+
+    def _fail(self, key, error):
+        """Log a failed job and remember it, so polls do not resubmit it right away."""
+        print(f"Analytics job for {key[0]} (state {key[2]}, cap {key[3]}) failed:")
+        traceback.print_exception(error)
+        message = f"{type(error).__name__}: {error}"
+        self._failures[key] = (time.monotonic(), message)
+        if len(self._failures) > self.maxsize:
+            self._failures.popitem(last=False)
+        return {"error": message}
+
+    def _store(self, key, value):
+        self._results[key] = value
+        if len(self._results) > self.maxsize:
+            self._results.popitem(last=False)
+        return value
+
+    def shutdown(self):
+        for pid, executor in list(self._executors.values()):
+            if pid == os.getpid():
+                executor.shutdown(cancel_futures=True)
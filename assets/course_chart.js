@@ -0,0 +1,147 @@
+/*
+ * Browser-side toggle and reset for the course graph.
+ *
+ * Mirrors CompletionState.toggle and patch_figure in main.py on the static
+ * catalog data that the server ships once in the "catalog-data" store, so a
+ * click costs no server round-trip. The state format is the one of
+ * ProgramCatalog.state_json: hex bitmasks plus per-group credit totals,
+ * tagged with the catalog version.
+ */
+window.dash_clientside = Object.assign({}, window.dash_clientside, {
+    course_chart: {
+        toggle: function (clickData, resetClicks, state, figure, catalog) {
+            const nc = window.dash_clientside.no_update;
+            const triggered = window.dash_clientside.callback_context.triggered.map(t => t.prop_id);
+            if (!figure || !catalog) {
+                return [nc, nc, nc];
+            }
+            // The focus view is rendered by the server: a click there moves
+            // the focus, and the reset is handled by the server callback
+            if (figure.layout.meta && figure.layout.meta.focus) {
+                const point = clickData && clickData.points && clickData.points[0];
+                const focused = triggered.includes("course-graph.clickData") && point && point.text in catalog.index;
+                return [nc, nc, focused ? point.text : nc];
+            }
+            const current = new Bitmask(state ? state.completed : catalog.default_state.completed);
+            const eligible = new Bitmask(state ? state.eligible : catalog.default_state.eligible);
+            const credits = (state || catalog.default_state).credits.slice();
+
+            let restyled = [];
+            let toggled = [];
+            let groups = [];
+            let next;
+            if (triggered.includes("reset-button.n_clicks")) {
+                next = catalog.default_state;
+                const target = new Bitmask(next.completed);
+                const targetEligible = new Bitmask(next.eligible);
+                for (let i = 0; i < catalog.credits.length; i++) {
+                    const completedChanged = current.get(i) !== target.get(i);
+                    if (completedChanged) {
+                        toggled.push(i);
+                    }
+                    if (completedChanged || eligible.get(i) !== targetEligible.get(i)) {
+                        restyled.push(i);
+                    }
+                }
+                groups = catalog.groups.map((_, g) => g).filter(g => credits[g] !== next.credits[g]);
+                current.bits = target.bits;
+                eligible.bits = targetEligible.bits;
+            } else {
+                const point = clickData && clickData.points && clickData.points[0];
+                const index = point ? catalog.index[point.text] : undefined;
+                if (index === undefined) {
+                    return [nc, nc, nc];
+                }
+                // Flip the course, adjust its group total and re-check only
+                // the courses that list it as a prerequisite
+                current.set(index, !current.get(index));
+                const group = catalog.group[index];
+                credits[group] += current.get(index) ? catalog.credits[index] : -catalog.credits[index];
+                toggled = [index];
+                restyled = [index];
+                groups = [group];
+                for (const dependent of catalog.dependents[index]) {
+                    const met = catalog.requirements[dependent].every(
+                        members => members.some(member => current.get(member))
+                    );
+                    if (met !== eligible.get(dependent)) {
+                        eligible.set(dependent, met);
+                        restyled.push(dependent);
+                    }
+                }
+                next = {
+                    completed: current.toString(), eligible: eligible.toString(), credits: credits,
+                    version: catalog.default_state.version
+                };
+            }
+
+            // Copy only the parts of the figure that change
+            const data = figure.data.slice();
+            const edges = Object.assign({}, data[1], {x: data[1].x.slice(), y: data[1].y.slice()});
+            for (const i of toggled) {
+                const completed = current.get(i);
+                for (const edge of catalog.out_edges[i]) {
+                    const [source, target] = catalog.edges[edge];
+                    const points = [catalog.pos[source], catalog.pos[target]];
+                    for (let offset = 0; offset < 2; offset++) {
+                        edges.x[3 * edge + offset] = completed ? points[offset][0] : null;
+                        edges.y[3 * edge + offset] = completed ? points[offset][1] : null;
+                    }
+                }
+            }
+            data[1] = edges;
+
+            const nodes = data[2];
+            const line = Object.assign({}, nodes.marker.line, {color: nodes.marker.line.color.slice()});
+            const marker = Object.assign({}, nodes.marker, {size: nodes.marker.size.slice(), line: line});
+            for (const i of restyled) {
+                const style = current.get(i) ? catalog.styles.completed
+                    : eligible.get(i) ? catalog.styles.eligible : catalog.styles.pending;
+                line.color[i] = style[0];
+                marker.size[i] = style[1];
+            }
+            data[2] = Object.assign({}, nodes, {marker: marker});
+
+            // Same text as group_label_text in main.py
+            const annotations = figure.layout.annotations.slice();
+            for (const g of groups) {
+                const name = catalog.groups[g];
+                annotations[g] = Object.assign({}, annotations[g], {
+                    text: `${name}<br>(${next.credits[g]}/${catalog.group_credits[g]} credits completed)`
+                });
+            }
+            const layout = Object.assign({}, figure.layout, {annotations: annotations});
+
+            return [Object.assign({}, figure, {data: data, layout: layout}), next, nc];
+        }
+    }
+});
+
+/* A bitmask kept as the hex digits written by Python's format(mask, "x"). */
+function Bitmask(hex) {
+    this.bits = hex.split("").reverse().map(digit => parseInt(digit, 16));
+}
+
+Bitmask.prototype.get = function (i) {
+    const digit = this.bits[i >> 2];
+    return digit !== undefined && ((digit >> (i & 3)) & 1) === 1;
+};
+
+Bitmask.prototype.set = function (i, value) {
+    while (this.bits.length <= (i >> 2)) {
+        this.bits.push(0);
+    }
+    if (value) {
+        this.bits[i >> 2] |= 1 << (i & 3);
+    } else {
+        this.bits[i >> 2] &= ~(1 << (i & 3));
+    }
+};
+
+Bitmask.prototype.toString = function () {
+    let end = this.bits.length;
+    while (end > 1 && this.bits[end - 1] === 0) {
+        end--;
+    }
+    return this.bits.slice(0, Math.max(end, 1)).reverse().map(digit => digit.toString(16)).join("") || "0";
+};
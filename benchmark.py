@@ -0,0 +1,199 @@
+"""Benchmarks of the load, build and render paths on synthetic catalogs.
+
+    python benchmark.py --sizes 1000 10000 100000 --output bench.json
+    python benchmark.py --compare bench.json
+
+For every size a catalog is generated with synthetic.py and each stage is
+timed (best of --repeat runs), then run once more under tracemalloc for its
+peak Python memory. The plan stage schedules every group requirement from
+an empty state, since the default state of a catalog may say little about
+the planner. The figure stages also report the JSON size the browser
+would receive. Results are written as JSON (to stdout unless --output is
+given) and summarized on stderr; with --compare the run exits with status 1
+if a stage got slower than the previous results by more than --tolerance.
+"""
+import argparse
+import json
+import platform
+import random
+import sys
+import tempfile
+import time
+import tracemalloc
+
+import plotly.io as pio
+
+import main
+import snapshot
+from eligibility import CompletionState
+from planner import Planner
+from synthetic import generate_catalog
+
+
+def measure(func, repeat, memory):
+    """Best wall time of func over repeat runs, its peak traced memory and its result."""
+    best = float("inf")
+    for _ in range(repeat):
+        start = time.perf_counter()
+        result = func()
+        best = min(best, time.perf_counter() - start)
+    peak = None
+    if memory:
+        tracemalloc.start()
+        func()
+        peak = tracemalloc.get_traced_memory()[1]
+        tracemalloc.stop()
+    return best, peak, result
+
+
+def patch_json(patched):
+    return json.dumps(patched.to_plotly_json())
+
+
+def bench_size(size, data_dir, args):
+    """Results of every stage for one catalog size, as a list of dicts."""
+    results = []
+
+    def stage(name, func, **extra):
+        seconds, peak, result = measure(func, args.repeat, not args.no_memory)
+        results.append(dict(courses=size, stage=name, seconds=seconds, peak_bytes=peak, **extra))
+        print(f"{size:>9} {name:<22} {seconds * 1000:>10.1f} ms"
+              + (f" {peak / 2 ** 20:>9.1f} MiB" if peak is not None else "")
+              + "".join(f" {key}={value}" for key, value in extra.items()), file=sys.stderr)
+        return result
+
+    classes_file, groups_file, prereqs_file = stage(
+        "generate", lambda: generate_catalog(size, data_dir, args.seed)
+    )
+
+    # Load
+    courses, group_colors = stage("parse_classes", lambda: main.parse_classes(classes_file, args.loader))
+    group_credits = stage("parse_group_credits", lambda: main.parse_group_credits(groups_file, args.loader))
+
+    def parse_prerequisites():
+        for course in courses.values():
+            course.prerequisites = []
+        main.parse_prerequisites(prereqs_file, courses, args.loader)
+    stage("parse_prerequisites", parse_prerequisites)
+    report = stage("check_catalog", lambda: main.check_catalog(courses, group_credits))
+
+    snapshot_file = f"{data_dir}/catalog.snapshot"
+    digest = snapshot.source_hash(classes_file, groups_file, prereqs_file)
+    stage("write_snapshot", lambda: snapshot.write_snapshot(
+        snapshot_file, digest, courses, group_colors, group_credits, report
+    ))
+    stage("load_snapshot", lambda: main.load_catalog(
+        classes_file, groups_file, prereqs_file, snapshot_path=snapshot_file, digest=digest
+    ))
+
+    # Build
+    model = stage("graph_model", lambda: main.GraphModel(courses, group_colors, reachability=False))
+    results[-1]["edges"] = len(model.edges)
+    if args.layered:
+        from layout import layered_layout
+        stage("layered_layout", lambda: layered_layout(model))
+    if size <= args.reachability_limit:
+        model.reachability = stage("reachability", lambda: main.ReachabilityIndex(model))
+
+    # Render: the page load and a click as update_graph handles them
+    default_state = CompletionState(model, model.default_completed).to_json()
+
+    def page_load():
+        state = CompletionState.from_json(model, default_state)
+        figure = main.create_figure(
+            model, state, group_colors, group_credits, typed_arrays=args.typed_arrays, validate=args.validate_figures
+        )
+        return figure, state.to_json()
+    figure, _ = stage("create_figure", page_load)
+    payload = stage("serialize_figure", lambda: pio.to_json(figure, validate=False))
+    results[-1]["json_bytes"] = len(payload)
+
+    rng = random.Random(args.seed)
+    clicks = [rng.randrange(len(model.nodes)) for _ in range(args.clicks)]
+
+    def click_path():
+        state_data = default_state
+        sizes = []
+        for node_index in clicks:
+            state = CompletionState.from_json(model, state_data)
+            changed = state.toggle(node_index)
+            sizes.append(len(patch_json(main.patch_toggle(model, state, group_credits, changed))))
+            state_data = state.to_json()
+        return sizes
+    sizes = stage("update_graph_clicks", click_path, clicks=len(clicks))
+    results[-1]["seconds_per_click"] = results[-1]["seconds"] / max(1, len(clicks))
+    results[-1]["mean_patch_bytes"] = sum(sizes) / max(1, len(sizes))
+
+    # Plan: a fresh planner each run, so the solver's cache doesn't hide the cost
+    if size <= args.plan_limit:
+        plan = stage("plan_empty_state", lambda: Planner(model, group_credits).plan(CompletionState(model, 0)))
+        results[-1]["terms"] = len(plan.terms)
+    return results
+
+
+def compare(results, previous, tolerance):
+    """(courses, stage, previous seconds, seconds) of the stages slower than tolerance allows."""
+    before = {(row["courses"], row["stage"]): row["seconds"] for row in previous["results"]}
+    return [
+        (row["courses"], row["stage"], before[row["courses"], row["stage"]], row["seconds"])
+        for row in results
+        if (row["courses"], row["stage"]) in before and row["seconds"] > before[row["courses"], row["stage"]] * tolerance
+    ]
+
+
+def parse_args(argv=None):
+    parser = argparse.ArgumentParser(description="Benchmark the course chart on synthetic catalogs")
+    parser.add_argument("--sizes", type=int, nargs="+", default=[1000, 10000, 100000],
+                        help="catalog sizes in courses (up to 1000000)")
+    parser.add_argument("--repeat", type=int, default=1, help="timed runs per stage; the best is reported")
+    parser.add_argument("--clicks", type=int, default=100, help="random clicks replayed per size")
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--loader", choices=["csv", "pyarrow"], default="csv")
+    parser.add_argument("--layered", action="store_true", help="also time the layered layout")
+    parser.add_argument("--validate-figures", action="store_true", help="build validated go.Figure objects")
+    parser.add_argument("--typed-arrays", action="store_true", help="send static coordinates as typed arrays")
+    parser.add_argument("--reachability-limit", type=int, default=main.REACHABILITY_LIMIT,
+                        help="skip the (quadratic) reachability index above this many courses "
+                             "(default: the size above which the app does not build it either)")
+    parser.add_argument("--plan-limit", type=int, default=20000,
+                        help="skip planning from an empty state above this many courses")
+    parser.add_argument("--no-memory", action="store_true", help="skip the tracemalloc pass")
+    parser.add_argument("--data-dir", help="keep the generated catalogs here instead of a temporary directory")
+    parser.add_argument("--output", help="write the JSON results here instead of stdout")
+    parser.add_argument("--compare", metavar="RESULTS", help="previous JSON results to check for regressions")
+    parser.add_argument("--tolerance", type=float, default=1.25,
+                        help="slowdown factor over --compare results that counts as a regression")
+    return parser.parse_args(argv)
+
+
+def run(args):
+    results = []
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        for size in args.sizes:
+            data_dir = f"{args.data_dir or tmp_dir}/{size}"
+            results.extend(bench_size(size, data_dir, args))
+
+    report = {
+        "python": platform.python_version(),
+        "platform": platform.platform(),
+        "args": {key: value for key, value in vars(args).items() if key not in ("output", "compare")},
+        "results": results,
+    }
+    text = json.dumps(report, indent=2)
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+
+    if args.compare:
+        with open(args.compare, encoding="utf-8") as f:
+            regressions = compare(results, json.load(f), args.tolerance)
+        for courses, name, before, after in regressions:
+            print(f"REGRESSION {courses} {name}: {before * 1000:.1f} ms -> {after * 1000:.1f} ms", file=sys.stderr)
+        return 1 if regressions else 0
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(run(parse_args()))
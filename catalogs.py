@@ -0,0 +1,193 @@
+"""Catalogs of several degree programs hosted by one process.
+
+Programs share most of their courses, so course records are kept once in a
+CourseRegistry: every distinct (number, name, credits, prerequisites) is a
+single SharedCourse with interned strings, and a program only adds a thin
+ProgramCourse per course holding its group and Completed: default, plus its
+own group colors and groups.csv thresholds. A course whose name, credits or
+prerequisites differ between programs simply gets a second record.
+
+The programs are listed in a JSON manifest:
+
+    {"programs": [
+        {"id": "ce", "title": "Computer Engineering",
+         "classes": "ce/classes.csv", "groups": "ce/groups.csv", "prereqs": "prereqs.tsv"},
+        ...
+    ]}
+
+with file paths relative to the manifest. A program can name a data source
+instead of the files (see sources.py); its caches are then kept next to the
+manifest. Without a manifest the single "default" program is read from
+./mnt/data.
+"""
+import json
+import os
+import re
+import sys
+import weakref
+
+from sources import make_source
+
+DEFAULT_PROGRAM = "default"
+PROGRAM_ID = re.compile(r"[A-Za-z0-9_-]+")
+
+
+class ManifestError(ValueError):
+    """Raised when the programs manifest is malformed."""
+
+
+class Program:
+    """One degree program: an id used in URLs and its three catalog files.
+
+    A program read from a data source has a source (a sources.py adapter)
+    instead of files, and a cache_dir for its derived files.
+    """
+
+    def __init__(self, program_id, title, classes_file, groups_file, prereqs_file, source=None, cache_dir=None):
+        self.id = program_id
+        self.title = title
+        self.classes_file = classes_file
+        self.groups_file = groups_file
+        self.prereqs_file = prereqs_file
+        self.source = source
+        self.cache_dir = cache_dir if cache_dir is not None else os.path.dirname(classes_file)
+
+    @property
+    def catalog_files(self):
+        """The three files, or None for a program read from a data source."""
+        if self.source is not None:
+            return None
+        return self.classes_file, self.groups_file, self.prereqs_file
+
+    def cache_file(self, name):
+        """Path of a derived file (snapshot, layout cache) next to the classes file or in cache_dir.
+
+        Prefixed with the program id unless this is the default program, so
+        programs sharing a directory do not overwrite each other's caches.
+        """
+        if self.id != DEFAULT_PROGRAM:
+            name = f"{self.id}.{name}"
+        return os.path.join(self.cache_dir, name)
+
+    def __repr__(self):
+        return f"Program({self.id}, {self.title})"
+
+
+def default_programs():
+    return [Program(
+        DEFAULT_PROGRAM, "Course Dependency Graph",
+        "./mnt/data/classes.csv", "./mnt/data/groups.csv", "./mnt/data/prereqs.tsv"
+    )]
+
+
+def load_manifest(path):
+    """Read the programs listed in a manifest, in order."""
+    with open(path, encoding="utf-8") as f:
+        manifest = json.load(f)
+    base = os.path.dirname(path)
+    programs = []
+    seen = set()
+    for entry in manifest.get("programs", []):
+        source = None
+        try:
+            program_id = entry["id"]
+            if "source" in entry:
+                files = [None] * 3
+            else:
+                files = [os.path.join(base, entry[key]) for key in ("classes", "groups", "prereqs")]
+        except (KeyError, TypeError) as error:
+            raise ManifestError(f"{path}: program entry {entry!r} is missing {error}") from None
+        if not PROGRAM_ID.fullmatch(program_id):
+            raise ManifestError(f"{path}: program id {program_id!r} must be letters, digits, '-' or '_'")
+        if program_id in seen:
+            raise ManifestError(f"{path}: duplicate program id {program_id!r}")
+        seen.add(program_id)
+        if "source" in entry:
+            try:
+                source = make_source(entry["source"])
+            except ValueError as error:
+                raise ManifestError(f"{path}: program {program_id!r}: {error}") from None
+        programs.append(Program(program_id, entry.get("title", program_id), *files, source,
+                                None if source is None else base))
+    if not programs:
+        raise ManifestError(f"{path}: no programs")
+    return programs
+
+
+class SharedCourse:
+    """The program-independent part of a course."""
+
+    __slots__ = ("class_number", "name", "credits", "prerequisites", "__weakref__")
+
+    def __init__(self, class_number, name, credits, prerequisites):
+        self.class_number = class_number
+        self.name = name
+        self.credits = credits
+        self.prerequisites = prerequisites
+
+
+class ProgramCourse:
+    """A course as seen by one program; reads like a main.Course."""
+
+    __slots__ = ("shared", "group", "completed")
+
+    def __init__(self, shared, group, completed):
+        self.shared = shared
+        self.group = group
+        self.completed = completed
+
+    @property
+    def class_number(self):
+        return self.shared.class_number
+
+    @property
+    def name(self):
+        return self.shared.name
+
+    @property
+    def credits(self):
+        return self.shared.credits
+
+    @property
+    def prerequisites(self):
+        return self.shared.prerequisites
+
+    def __repr__(self):
+        return f"Course({self.class_number}, {self.name}, {self.group}, {self.credits}, {self.completed}, {self.prerequisites})"
+
+
+class CourseRegistry:
+    """Interned course records shared by every program loaded in a process.
+
+    Records are held weakly, so the ones no program uses any more after a
+    reload are freed.
+    """
+
+    def __init__(self):
+        self.records = weakref.WeakValueDictionary()
+
+    def share(self, courses, group_colors, group_credits):
+        """Replace a freshly loaded catalog by views onto the shared records.
+
+        Takes and returns (courses, group_colors, group_credits) as produced
+        by main.load_catalog. Prerequisites become tuples, so the shared
+        records cannot be modified through one program.
+        """
+        shared = {}
+        for class_number, course in courses.items():
+            prerequisites = tuple(
+                tuple(sys.intern(prereq) for prereq in prereq_group) for prereq_group in course.prerequisites
+            )
+            key = (course.class_number, course.name, course.credits, prerequisites)
+            record = self.records.get(key)
+            if record is None:
+                record = self.records[key] = SharedCourse(
+                    sys.intern(course.class_number), sys.intern(course.name), course.credits, prerequisites
+                )
+            shared[record.class_number] = ProgramCourse(record, sys.intern(course.group), course.completed)
+        group_colors = {sys.intern(group): color for group, color in group_colors.items()}
+        group_credits = {sys.intern(group): credits for group, credits in group_credits.items()}
+        return shared, group_colors, group_credits
+
+    def __len__(self):
+        return len(self.records)
@@ -0,0 +1,92 @@
+import numpy as np
+
+
+class CourseStore:
+    """Columnar copy of the catalog, indexed in GraphModel node order.
+
+    Credits and group ids live in numpy arrays and the prerequisite groups
+    are CSR-encoded, so per-state quantities (trace arrays, group credit
+    totals, edge satisfaction) are each one vectorized operation over a
+    boolean completion array instead of a walk over Course objects. The store
+    itself holds no completion state and can be shared between sessions.
+    """
+
+    def __init__(self, model, courses, group_colors, group_credits):
+        self.groups = list(group_colors)
+        self.group_id = {group: i for i, group in enumerate(self.groups)}
+        self.group_credits = group_credits
+
+        self.size = len(model.nodes)
+        self.credits = np.array([courses[node].credits for node in model.nodes], dtype=np.int64)
+        self.group_ids = np.array([self.group_id[courses[node].group] for node in model.nodes], dtype=np.int64)
+
+        # Prerequisites in CSR form: the groups of course i are
+        # prereq_group_ptr[i]:prereq_group_ptr[i + 1], and the courses of
+        # group g are prereq_items[prereq_item_ptr[g]:prereq_item_ptr[g + 1]].
+        group_ptr = [0]
+        item_ptr = [0]
+        items = []
+        for node in model.nodes:
+            for prereq_group in courses[node].prerequisites:
+                items.extend(model.node_index[prereq] for prereq in prereq_group)
+                item_ptr.append(len(items))
+            group_ptr.append(len(item_ptr) - 1)
+        self.prereq_group_ptr = np.array(group_ptr, dtype=np.int64)
+        self.prereq_item_ptr = np.array(item_ptr, dtype=np.int64)
+        self.prereq_items = np.array(items, dtype=np.int64)
+
+        # Static geometry; edge segments are (E, 3) with None as the separator
+        self.edge_source = np.array([source for source, _ in model.edges], dtype=np.int64)
+        node_x = np.array(model.node_x, dtype=object)
+        node_y = np.array(model.node_y, dtype=object)
+        edge_target = np.array([target for _, target in model.edges], dtype=np.int64)
+        gap = np.full(len(model.edges), None, dtype=object)
+        self.edge_segments_x = np.column_stack([node_x[self.edge_source], node_x[edge_target], gap])
+        self.edge_segments_y = np.column_stack([node_y[self.edge_source], node_y[edge_target], gap])
+
+    def flags(self, mask):
+        """Unpack a completion bitmask (bit i for node i) into a boolean array."""
+        data = np.frombuffer(mask.to_bytes((self.size + 7) // 8, "little"), dtype=np.uint8)
+        return np.unpackbits(data, count=self.size, bitorder="little").astype(bool)
+
+    def edge_satisfied(self, completed):
+        """Whether the source course of every edge is completed."""
+        return completed[self.edge_source]
+
+    def eligible(self, completed):
+        """Whether every prerequisite group of each course is met.
+
+        Prefix sums over the CSR arrays count the completed courses of each
+        group and the unmet groups of each course in two vectorized passes;
+        empty groups (only courses outside the catalog) are ignored.
+        """
+        hits = np.concatenate([[0], np.cumsum(completed[self.prereq_items])])
+        group_hits = hits[self.prereq_item_ptr[1:]] - hits[self.prereq_item_ptr[:-1]]
+        group_empty = self.prereq_item_ptr[1:] == self.prereq_item_ptr[:-1]
+        unmet = np.concatenate([[0], np.cumsum((group_hits == 0) & ~group_empty)])
+        return unmet[self.prereq_group_ptr[1:]] == unmet[self.prereq_group_ptr[:-1]]
+
+    def group_completed_credits(self, completed):
+        """Sum the credits of completed courses per group."""
+        totals = np.bincount(self.group_ids, weights=self.credits * completed, minlength=len(self.groups))
+        return {
+            group: int(totals[self.group_id[group]]) if group in self.group_id else 0
+            for group in self.group_credits
+        }
+
+    def trace_arrays(self, completed, completed_style, eligible_style, pending_style):
+        """Per-state edge and node trace arrays, see main.build_trace_arrays.
+
+        The styles are (border color, size) pairs for completed, eligible and
+        other courses.
+        """
+        satisfied = self.edge_satisfied(completed)[:, None]
+        choices = [completed, self.eligible(completed)]
+        # Returned as lists with None gaps: these arrays are patched in the
+        # browser, and plotly would otherwise send numpy arrays base64-encoded
+        return {
+            "satisfied_edge_x": np.where(satisfied, self.edge_segments_x, None).ravel().tolist(),
+            "satisfied_edge_y": np.where(satisfied, self.edge_segments_y, None).ravel().tolist(),
+            "node_border_color": np.select(choices, [completed_style[0], eligible_style[0]], pending_style[0]).tolist(),
+            "node_size": np.select(choices, [completed_style[1], eligible_style[1]], pending_style[1]).tolist(),
+        }
@@ -0,0 +1,149 @@
+def mask_from_indices(indices, size):
+    """Build a bitmask with the given bits set in O(size) time."""
+    data = bytearray((size + 7) // 8)
+    for i in indices:
+        data[i >> 3] |= 1 << (i & 7)
+    return int.from_bytes(data, "little")
+
+
+def mask_to_flags(mask, size):
+    """The bits of a bitmask as a string of "0"/"1", character i for bit i."""
+    return format(mask, f"0{size}b")[::-1] if size else ""
+
+
+class PrerequisiteEngine:
+    """Prerequisite expressions compiled to bitsets over GraphModel node indices.
+
+    A course's prerequisites are an AND of groups, each group an OR of
+    courses. Every group is compiled to one integer whose bit i is set when
+    course i satisfies it, so a group is met when it shares a bit with the
+    completed bitmask and eligibility is word-wise AND over the two; every
+    prerequisite is in the catalog, see validation.check_catalog. The same
+    groups are also kept as lists of node indices in alternatives, for
+    algorithms that need to pick a member.
+    """
+
+    def __init__(self, model, courses):
+        self.size = len(model.nodes)
+        self.requirements = []
+        self.alternatives = []
+        for node in model.nodes:
+            masks = []
+            groups = []
+            for prereq_group in courses[node].prerequisites:
+                members = sorted({model.node_index[prereq] for prereq in prereq_group})
+                mask = 0
+                for member in members:
+                    mask |= 1 << member
+                masks.append(mask)
+                groups.append(members)
+            self.requirements.append(masks)
+            self.alternatives.append(groups)
+
+        # Reverse adjacency: the courses that list course i in one of their
+        # prerequisite groups, i.e. whose eligibility can change with course i
+        dependents = [set() for _ in model.nodes]
+        for i, groups in enumerate(self.alternatives):
+            for members in groups:
+                for member in members:
+                    dependents[member].add(i)
+        self.dependents = [sorted(targets) for targets in dependents]
+
+    @staticmethod
+    def completed_mask(model, courses):
+        """Bitmask of the completed courses, bit i for model.nodes[i]."""
+        return mask_from_indices(
+            (i for i, node in enumerate(model.nodes) if courses[node].completed), len(model.nodes)
+        )
+
+    def is_eligible(self, node_index, completed):
+        """Whether every prerequisite group of a course is met."""
+        for mask in self.requirements[node_index]:
+            if not completed & mask:
+                return False
+        return True
+
+    def eligible_mask(self, completed):
+        """Bitmask of the courses whose prerequisites are all met."""
+        eligible = []
+        for i, masks in enumerate(self.requirements):
+            for mask in masks:
+                if not completed & mask:
+                    break
+            else:
+                eligible.append(i)
+        return mask_from_indices(eligible, self.size)
+
+
+class CompletionState:
+    """Completion bitmask of one student and the quantities derived from it.
+
+    Eligibility and group credit totals are computed in full once and then
+    kept up to date by toggle(), which only revisits the dependents of the
+    toggled course.
+    """
+
+    def __init__(self, model, completed):
+        self.model = model
+        self.completed = completed
+        self.eligible = model.engine.eligible_mask(completed)
+        self.group_completed_credits = {group: 0 for group in model.groups}
+        for i in range(len(model.nodes)):
+            if completed >> i & 1:
+                self.group_completed_credits[model.node_group[i]] += model.node_credits[i]
+
+    def copy(self):
+        state = CompletionState.__new__(CompletionState)
+        state.model = self.model
+        state.completed = self.completed
+        state.eligible = self.eligible
+        state.group_completed_credits = dict(self.group_completed_credits)
+        return state
+
+    def to_json(self):
+        """Compact, JSON-serializable form of the state for a dcc.Store.
+
+        The derived eligibility and credit totals are stored alongside the
+        completion bitmask so that restoring a state does not need a full
+        re-evaluation.
+        """
+        return {
+            "completed": format(self.completed, "x"),
+            "eligible": format(self.eligible, "x"),
+            "credits": [self.group_completed_credits[group] for group in self.model.groups],
+        }
+
+    @classmethod
+    def from_json(cls, model, data):
+        state = cls.__new__(cls)
+        state.model = model
+        state.completed = int(data["completed"], 16)
+        state.eligible = int(data["eligible"], 16)
+        state.group_completed_credits = dict(zip(model.groups, data["credits"]))
+        return state
+
+    def is_completed(self, node_index):
+        return bool(self.completed >> node_index & 1)
+
+    def is_eligible(self, node_index):
+        return bool(self.eligible >> node_index & 1)
+
+    def toggle(self, node_index):
+        """Flip the completion of one course.
+
+        Returns the indices of the courses whose completion or eligibility
+        changed, starting with the toggled course.
+        """
+        model = self.model
+        self.completed ^= 1 << node_index
+        credits = model.node_credits[node_index]
+        if not self.is_completed(node_index):
+            credits = -credits
+        self.group_completed_credits[model.node_group[node_index]] += credits
+
+        changed = [node_index]
+        for dependent in model.engine.dependents[node_index]:
+            if model.engine.is_eligible(dependent, self.completed) != self.is_eligible(dependent):
+                self.eligible ^= 1 << dependent
+                changed.append(dependent)
+        return changed
@@ -0,0 +1,178 @@
+"""Static export of course charts, without a Dash server.
+
+    python export.py out/                                  # the default state, out/chart.html
+    python export.py out/ --transcripts transcripts.csv    # one chart per student
+    python export.py out/ --transcripts transcripts.csv --format png --workers 4
+
+Charts are drawn by create_figure, as in the app, for the default
+Completed: column or for every student of a transcripts file (the format of
+transcripts.py); a student's chart is written as <student id>.<format>,
+with a -2, -3, ... suffix when two ids come out as the same file name.
+
+HTML files reference one plotly.js bundle instead of inlining the 3 MB
+bundle in every file: plotly.min.js is written once next to them, or
+--plotlyjs names a URL (or "cdn") to load it from. PNG, SVG and PDF images
+are rendered with kaleido. Starting kaleido's browser takes far longer than
+rendering one chart, so every worker process starts it once and keeps it
+for all the charts it renders; students are handed out in chunks.
+"""
+import argparse
+from collections import deque
+from concurrent.futures import ProcessPoolExecutor
+import os
+import re
+import sys
+import time
+
+from catalogs import DEFAULT_PROGRAM
+from eligibility import CompletionState
+from transcripts import completion_mask, load_model, read_chunks, select_program
+
+IMAGE_FORMATS = ["png", "svg", "pdf"]
+PLOTLYJS_FILE = "plotly.min.js"
+
+_catalog = None
+
+
+def _start_kaleido():
+    try:
+        import kaleido
+    except ImportError:
+        raise SystemExit("image export needs the kaleido package") from None
+    # kaleido >= 1 keeps one browser per process once its server is started;
+    # 0.x keeps its subprocess alive after the first image by itself
+    start = getattr(kaleido, "start_sync_server", None)
+    if start is not None:
+        start(silence_warnings=True)
+
+
+def _init_worker(catalog_files, snapshot_path, images):
+    global _catalog
+    _catalog = load_model(catalog_files, snapshot_path)
+    if images:
+        _start_kaleido()
+
+
+def file_name(student):
+    """A file name for a student id, keeping only safe characters."""
+    return re.sub(r"[^A-Za-z0-9_.-]", "_", student).lstrip(".") or "_"
+
+
+def named_chunks(chunks):
+    """Chunks of (student id, courses, file name), the names unique even on case-insensitive file systems."""
+    used = set()
+    for chunk in chunks:
+        named = []
+        for student, course_list in chunk:
+            base = name = file_name(student)
+            suffix = 1
+            while name.casefold() in used:
+                suffix += 1
+                name = f"{base}-{suffix}"
+            if suffix > 1:
+                print(f"{student!r}: {base} is taken, writing {name} instead", file=sys.stderr)
+            used.add(name.casefold())
+            named.append((student, course_list, name))
+        yield named
+
+
+def write_chart(catalog, completed, title, path, args):
+    import plotly.io as pio
+    from main import create_figure
+
+    model, group_colors, group_credits = catalog
+    figure = create_figure(model, CompletionState(model, completed), group_colors, group_credits)
+    figure["layout"]["title"]["text"] = title
+    if args.format == "html":
+        pio.write_html(figure, path, include_plotlyjs=args.plotlyjs or PLOTLYJS_FILE, full_html=True, validate=False)
+    else:
+        pio.write_image(
+            figure, path, format=args.format, width=args.width, height=args.height, scale=args.scale, validate=False
+        )
+
+
+def write_charts(catalog, students, args):
+    """Write the charts of a chunk of named_chunks; returns the number written."""
+    for student, course_list, name in students:
+        completed, _ = completion_mask(catalog[0], course_list)
+        path = os.path.join(args.out_dir, f"{name}.{args.format}")
+        write_chart(catalog, completed, f"Course progress of {student}", path, args)
+    return len(students)
+
+
+def _run_chunk(students, args):
+    return write_charts(_catalog, students, args)
+
+
+def write_plotlyjs(out_dir):
+    """Write the plotly.js bundle the HTML files share, once."""
+    from plotly.offline import get_plotlyjs
+
+    path = os.path.join(out_dir, PLOTLYJS_FILE)
+    if not os.path.exists(path):
+        with open(path, "w", encoding="utf-8") as f:
+            f.write(get_plotlyjs())
+
+
+def run(args):
+    """Write the charts; returns the number written."""
+    program, snapshot_path = select_program(args)
+    catalog = load_model(program.catalog_files, snapshot_path)
+    images = args.format in IMAGE_FORMATS
+    os.makedirs(args.out_dir, exist_ok=True)
+    if args.format == "html" and not args.plotlyjs:
+        write_plotlyjs(args.out_dir)
+
+    start = time.perf_counter()
+    chunks = named_chunks(read_chunks(args.transcripts, args.chunk_rows)) if args.transcripts else None
+    if not args.transcripts:
+        if images:
+            _start_kaleido()
+        model = catalog[0]
+        path = os.path.join(args.out_dir, f"chart.{args.format}")
+        write_chart(catalog, model.default_completed, program.title, path, args)
+        written = 1
+    elif args.workers <= 0:
+        if images:
+            _start_kaleido()
+        written = sum(write_charts(catalog, chunk, args) for chunk in chunks)
+    else:
+        with ProcessPoolExecutor(
+            args.workers, initializer=_init_worker, initargs=(program.catalog_files, snapshot_path, images)
+        ) as pool:
+            # At most 2 * workers chunks in flight, so large files are not
+            # read into memory ahead of the workers
+            pending = deque()
+            written = 0
+            for chunk in chunks:
+                pending.append(pool.submit(_run_chunk, chunk, args))
+                while len(pending) >= 2 * args.workers:
+                    written += pending.popleft().result()
+            while pending:
+                written += pending.popleft().result()
+    seconds = time.perf_counter() - start
+    print(f"{written} chart(s) in {seconds:.1f} s", file=sys.stderr)
+    return written
+
+
+def parse_args(argv=None):
+    parser = argparse.ArgumentParser(description="Export course charts as standalone HTML files or images")
+    parser.add_argument("out_dir", help="directory for the charts")
+    parser.add_argument("--transcripts", help="one chart per student of this file (see transcripts.py)")
+    parser.add_argument("--format", choices=["html"] + IMAGE_FORMATS, default="html")
+    parser.add_argument("--plotlyjs", metavar="URL",
+                        help=f"URL of the plotly.js the HTML files load, or cdn (default: {PLOTLYJS_FILE} in out_dir)")
+    parser.add_argument("--width", type=int, default=1400, help="image width in pixels")
+    parser.add_argument("--height", type=int, default=1000, help="image height in pixels")
+    parser.add_argument("--scale", type=float, default=1, help="image scale factor")
+    parser.add_argument("--programs", help="programs manifest (JSON); the catalog of --program is used")
+    parser.add_argument("--program", default=DEFAULT_PROGRAM, help="program id in the manifest")
+    parser.add_argument("--workers", type=int, default=os.cpu_count() or 1,
+                        help="worker processes, each with its own kaleido (0 renders in this process)")
+    parser.add_argument("--chunk-rows", type=int, default=64, help="students per job of a worker")
+    parser.add_argument("--no-snapshot", action="store_true", help="parse the catalog text files")
+    return parser.parse_args(argv)
+
+
+if __name__ == "__main__":
+    run(parse_args())
@@ -0,0 +1,85 @@
+"""Bounded cache of serialized figures.
+
+Figure JSON is kept in an LRU bounded by its total size. Inside a request
+get() returns a placeholder string, which install()'s after_request hook
+replaces with the cached JSON, so a repeated state is neither rendered nor
+serialized again.
+"""
+from collections import OrderedDict
+import json
+import threading
+import uuid
+
+import metrics
+
+_UPDATE_PATH = "/_dash-update-component"
+
+
+class FigureCache:
+    """LRU of figure JSON of at most max_bytes in total; max_bytes 0 disables caching."""
+
+    def __init__(self, max_bytes=64 * 2 ** 20):
+        self.max_bytes = max_bytes
+        self.size = 0
+        self._lock = threading.Lock()
+        self._figures = OrderedDict()
+        metrics.FIGURE_CACHE_BYTES.set(0, kind="cached")
+        metrics.FIGURE_CACHE_BYTES.set(max(0, max_bytes), kind="max")
+
+    def get(self, key, render):
+        """The figure cached under key, or render() which is then cached.
+
+        In a request the figure is a placeholder for its JSON, see install.
+        """
+        if self.max_bytes <= 0:
+            return render()
+        with self._lock:
+            payload = self._figures.get(key)
+            if payload is not None:
+                self._figures.move_to_end(key)
+        if payload is not None:
+            metrics.FIGURE_CACHE.inc(result="hit")
+            return _placeholder(payload)
+
+        # Rendered outside the lock; two requests for a new state may both
+        # render it, which is cheaper than serializing all renders
+        import plotly.io as pio
+
+        payload = pio.to_json(render(), validate=False).encode()
+        with self._lock:
+            if key not in self._figures and len(payload) <= self.max_bytes:
+                self._figures[key] = payload
+                self.size += len(payload)
+            while self.size > self.max_bytes:
+                _, evicted = self._figures.popitem(last=False)
+                self.size -= len(evicted)
+            metrics.FIGURE_CACHE_BYTES.set(self.size, kind="cached")
+        metrics.FIGURE_CACHE.inc(result="miss")
+        return _placeholder(payload)
+
+    def install(self, server):
+        """Put the cached JSON into Dash callback responses; install after Compress and metrics."""
+        import flask
+
+        @server.after_request
+        def insert_figures(response):
+            figures = flask.g.pop("course_chart_figures", None)
+            if figures and flask.request.path.endswith(_UPDATE_PATH) and not response.direct_passthrough:
+                body = response.get_data()
+                for token, payload in figures.items():
+                    body = body.replace(json.dumps(token).encode(), payload, 1)
+                response.set_data(body)
+            return response
+
+
+def _placeholder(payload):
+    """A string standing for payload in the response of the current request, or the figure itself outside one."""
+    import flask
+
+    if not flask.has_request_context():
+        return json.loads(payload)
+    token = f"course-chart-figure-{uuid.uuid4().hex}"
+    if "course_chart_figures" not in flask.g:
+        flask.g.course_chart_figures = {}
+    flask.g.course_chart_figures[token] = payload
+    return token
@@ -0,0 +1,16 @@
+# gunicorn -c gunicorn.conf.py wsgi:application
+import multiprocessing
+import os
+
+bind = os.environ.get("COURSE_CHART_BIND", "0.0.0.0:8050")
+workers = int(os.environ.get("COURSE_CHART_WORKERS", multiprocessing.cpu_count() * 2 + 1))
+threads = int(os.environ.get("COURSE_CHART_THREADS", 4))
+
+# Every worker runs its own what-if batch pool; wsgi.py sizes it to the
+# worker's share of the CPUs, so it needs the worker count
+os.environ["COURSE_CHART_WORKERS"] = str(workers)
+
+# Load the catalog once in the master, before forking
+preload_app = True
+reload = False
+timeout = 60
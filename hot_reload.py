@@ -0,0 +1,279 @@
+"""Reloading of a program's catalog files while the server runs.
+
+A LiveCatalog holds the current ProgramCatalog of one program and polls the
+modification time and size of its three files from a background thread.
+A program read from a data source is pulled (see sources.py) by one
+process only, the one holding its source.lock; it rewrites the snapshot,
+and the other processes poll that instead of the source.
+When a file changes, only that file is parsed again; the other parts are taken
+from the catalog in memory (prereqs.tsv is read again as well when
+classes.csv changed, since its rows are matched against the classes). The
+result is diffed against the current catalog and swapped in with a single
+reference assignment, reusing the layout when the topology is unchanged,
+and only the cached analytics of that program are dropped.
+
+Completion states carry the version of the catalog they were made for, so
+sessions survive a reload: a state of a recent older version is carried
+over to the new catalog course by course.
+"""
+from collections import OrderedDict
+import os
+import threading
+import time
+
+import snapshot
+from eligibility import CompletionState, mask_from_indices
+from validation import check_catalog
+
+
+class CatalogDiff:
+    """What a reload changed: course numbers and groups, and whether any edge or group moved."""
+
+    def __init__(self, added, removed, changed, groups, topology_changed):
+        self.added = added
+        self.removed = removed
+        self.changed = changed
+        self.groups = groups
+        self.topology_changed = topology_changed
+
+    def __bool__(self):
+        return bool(self.added or self.removed or self.changed or self.groups or self.topology_changed)
+
+    def __repr__(self):
+        return (
+            f"CatalogDiff({len(self.added)} added, {len(self.removed)} removed, {len(self.changed)} changed, "
+            f"{len(self.groups)} group threshold(s), topology {'changed' if self.topology_changed else 'kept'})"
+        )
+
+
+def diff_catalogs(old, new):
+    """Compare two ProgramCatalogs of the same program."""
+    def fields(course):
+        return course.name, course.credits, course.group, course.completed, [list(g) for g in course.prerequisites]
+
+    added = sorted(set(new.courses) - set(old.courses))
+    removed = sorted(set(old.courses) - set(new.courses))
+    changed = sorted(
+        number for number in set(old.courses) & set(new.courses)
+        if fields(old.courses[number]) != fields(new.courses[number])
+    )
+    groups = sorted(
+        group for group in set(old.group_credits) | set(new.group_credits)
+        if old.group_credits.get(group) != new.group_credits.get(group)
+    )
+    topology_changed = not (
+        new.model.nodes == old.model.nodes and new.model.edges == old.model.edges
+        and new.model.groups == old.model.groups and new.model.node_group == old.model.node_group
+    )
+    return CatalogDiff(added, removed, changed, groups, topology_changed)
+
+
+class LiveCatalog:
+    """The current catalog of one program, replaced when its files change.
+
+    interval is the polling period in seconds (0 disables watching) and
+    pull_interval the period of the pulls of a data source.
+    """
+
+    def __init__(self, args, catalog, registry, analytics, interval=2.0, history=4, pull_interval=300.0):
+        self.args = args
+        self.catalog = catalog
+        self.registry = registry
+        self.analytics = analytics
+        self.interval = interval
+        self.pull_interval = pull_interval
+        self.history = history
+        self._models = OrderedDict([(catalog.version, catalog.model)])
+        self._file_stats = catalog.file_stats
+        self._lock = threading.Lock()
+        self._watcher_pid = None
+        self._pulled_at = time.monotonic()
+        self._lock_file = None
+        self._lock_pid = None
+
+    def get(self):
+        """The current ProgramCatalog; callers should read it once per request."""
+        if self.interval > 0 and self._watcher_pid != os.getpid():
+            self._watcher_pid = os.getpid()
+            threading.Thread(target=self._watch, name=f"watch-{self.catalog.program.id}", daemon=True).start()
+        return self.catalog
+
+    def restore(self, state_data):
+        """The catalog and CompletionState for a session's stored state.
+
+        A state of an older, still remembered catalog version is carried
+        over by course number; an unknown one falls back to the default.
+        """
+        catalog = self.get()
+        if state_data is None:
+            state_data = catalog.default_state
+        version = state_data.get("version", catalog.version)
+        if version == catalog.version:
+            return catalog, CompletionState.from_json(catalog.model, state_data)
+        old_model = self._models.get(version)
+        if old_model is None:
+            return catalog, CompletionState.from_json(catalog.model, catalog.default_state)
+        completed = int(state_data["completed"], 16)
+        model = catalog.model
+        indices = (
+            model.node_index[node] for i, node in enumerate(old_model.nodes)
+            if completed >> i & 1 and node in model.node_index
+        )
+        return catalog, CompletionState(model, mask_from_indices(indices, len(model.nodes)))
+
+    def _watch(self):
+        while True:
+            time.sleep(self.interval)
+            if (self.catalog.source_sync is not None and time.monotonic() - self._pulled_at < self.pull_interval
+                    and self._leads()):
+                continue
+            try:
+                self.check()
+            except Exception as error:  # a half-written file must not kill the watcher
+                print(f"Reloading {self.catalog.program.id} failed: {error}")
+
+    def check(self):
+        """Reload the catalog if one of its files or its source changed; returns the CatalogDiff or None."""
+        with self._lock:
+            old = self.catalog
+            program = old.program
+            if old.source_sync is None:
+                new = self._read_files(old)
+            else:
+                new = self._pull(old) if self._leads() else self._follow(old)
+            if new is None:
+                return None
+            diff = diff_catalogs(old, new)
+
+            self._models[new.version] = new.model
+            while len(self._models) > self.history:
+                self._models.popitem(last=False)
+            self.catalog = new
+            self.analytics.replace(program.id, new.version, new.model, new.group_credits)
+        print(f"Reloaded {program.id}: {diff}")
+        return diff
+
+    def _read_files(self, old):
+        from main import catalog_file_stats
+
+        program = old.program
+        file_stats = catalog_file_stats(program.catalog_files)
+        if file_stats == self._file_stats:
+            return None
+        changed_files = [new != current for new, current in zip(file_stats, old.file_stats)]
+        digest = snapshot.source_hash(*program.catalog_files)
+        if digest == old.digest:
+            # Touched but not edited
+            self._file_stats = file_stats
+            return None
+        # A file that fails to parse is retried on its next change
+        self._file_stats = file_stats
+        return self._reload(old, changed_files, digest, file_stats)
+
+    def _leads(self):
+        """Whether this process pulls the data source, taking over when the process that did has exited."""
+        if self._lock_pid == os.getpid():
+            return True
+        try:
+            import fcntl
+        except ImportError:  # no flock: every process pulls for itself
+            return True
+        lock_file = open(self.catalog.program.cache_file("source.lock"), "a")
+        try:
+            fcntl.flock(lock_file, fcntl.LOCK_EX | fcntl.LOCK_NB)
+        except OSError:
+            lock_file.close()
+            return False
+        # Kept open for the life of the process; the previous holder may
+        # have pulled since this process forked
+        self._lock_file = lock_file
+        self._lock_pid = os.getpid()
+        self.catalog.source_sync.read_state()
+        return True
+
+    def _follow(self, old):
+        """The catalog of the snapshot the pulling process wrote, if it is new."""
+        from main import ProgramCatalog, catalog_file_stats, snapshot_courses
+
+        try:
+            file_stats = catalog_file_stats([old.snapshot_file])
+        except FileNotFoundError:
+            return None
+        if file_stats == self._file_stats:
+            return None
+        self._file_stats = file_stats
+        digest = snapshot.snapshot_digest(old.snapshot_file)
+        cached = None if digest in (None, old.digest) else snapshot.read_snapshot(old.snapshot_file, digest)
+        if cached is None:
+            return None
+        rows, group_colors, group_credits, report = cached
+        courses = snapshot_courses(rows)
+        if report is None:
+            check_catalog(courses, group_credits, strict=self.args.strict_catalog)
+        else:
+            report.enforce(self.args.strict_catalog)
+        catalog = self.registry.share(courses, group_colors, group_credits)
+        return ProgramCatalog(self.args, old.program, *catalog, digest, None, previous=old.model,
+                              source_sync=old.source_sync)
+
+    def _pull(self, old):
+        from main import ProgramCatalog, load_source_catalog
+
+        # Only the rows changed since the last pull are fetched; a catalog
+        # refused by check_catalog is retried on the source's next change
+        sync = old.source_sync
+        self._pulled_at = time.monotonic()
+        if not sync.pull():
+            return None
+        problems = []
+        catalog = self.registry.share(*load_source_catalog(
+            sync, old.snapshot_file, self.args.strict_catalog, problems
+        ))
+        for line in problems[0].lines():
+            print(f"{old.program.id}: {line}")
+        return ProgramCatalog(self.args, old.program, *catalog, sync.digest(), None, previous=old.model,
+                              source_sync=sync)
+
+    def _reload(self, old, changed_files, digest, file_stats):
+        from main import Course, ProgramCatalog, parse_classes, parse_group_credits, parse_prerequisites
+
+        args = self.args
+        program = old.program
+        classes_changed, groups_changed, prereqs_changed = changed_files
+
+        # Private, mutable Course objects for the parsers, from the new
+        # classes file or from the catalog in memory
+        duplicates = []
+        if classes_changed:
+            courses, group_colors = parse_classes(program.classes_file, args.loader, duplicates=duplicates)
+        else:
+            group_colors = dict(old.group_colors)
+            courses = {}
+            for class_number, course in old.courses.items():
+                courses[class_number] = Course(
+                    class_number, course.name, course.group, course.credits, "true" if course.completed else "false"
+                )
+        if classes_changed or prereqs_changed:
+            parse_prerequisites(program.prereqs_file, courses, args.loader)
+        else:
+            for class_number, course in courses.items():
+                course.prerequisites = [list(group) for group in old.courses[class_number].prerequisites]
+        if groups_changed:
+            group_credits = parse_group_credits(program.groups_file, args.loader)
+        else:
+            group_credits = dict(old.group_credits)
+
+        # A catalog with a cycle (or any problem, when strict) is refused and
+        # the current one kept
+        report = check_catalog(courses, group_credits, duplicates, args.strict_catalog)
+        for line in report.lines():
+            print(f"{program.id}: {line}")
+
+        catalog = self.registry.share(courses, group_colors, group_credits)
+        if old.snapshot_file:
+            # Analytics workers and restarts load the new version from here
+            try:
+                snapshot.write_snapshot(old.snapshot_file, digest, *catalog, report)
+            except OSError as error:
+                print(f"Could not write catalog snapshot {old.snapshot_file}: {error}")
+        return ProgramCatalog(args, program, *catalog, digest, file_stats, previous=old.model)
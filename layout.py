@@ -0,0 +1,130 @@
+"""Layered (Sugiyama-style) layout of the prerequisite DAG.
+
+Courses are ranked by their longest prerequisite chain and every rank
+becomes a column; the order within each column is then improved with
+barycenter sweeps to reduce edge crossings. The result only depends on the
+catalog, so it is persisted next to the catalog data and recomputed only
+when the catalog version changes.
+"""
+import json
+import os
+
+HORIZONTAL_SPACING = 5
+VERTICAL_SPACING = 3
+SWEEPS = 8
+
+
+def longest_path_ranks(model):
+    """Rank of every node: the length of its longest prerequisite chain.
+
+    The graph is acyclic (validation.check_catalog refuses cycles), so
+    Kahn's algorithm ranks every node.
+    """
+    size = len(model.nodes)
+    in_degree = [0] * size
+    for _, target in model.edges:
+        in_degree[target] += 1
+
+    ranks = [0] * size
+    ready = [i for i in range(size) if in_degree[i] == 0]
+    while ready:
+        source = ready.pop()
+        for edge_index in model.out_edges[source]:
+            target = model.edges[edge_index][1]
+            ranks[target] = max(ranks[target], ranks[source] + 1)
+            in_degree[target] -= 1
+            if in_degree[target] == 0:
+                ready.append(target)
+    return ranks
+
+
+def reduce_crossings(layers, predecessors, successors, sweeps=SWEEPS):
+    """Reorder every layer in place by the barycenter of its neighbors.
+
+    Downward sweeps use the positions of a node's prerequisites, upward
+    sweeps those of its dependents; nodes without neighbors on that side keep
+    their current position.
+    """
+    position = {}
+    for layer in layers:
+        for order, node in enumerate(layer):
+            position[node] = order / max(len(layer), 1)
+
+    def sweep(ordered_layers, neighbors):
+        for layer in ordered_layers:
+            def barycenter(node):
+                adjacent = neighbors[node]
+                if not adjacent:
+                    return position[node]
+                return sum(position[other] for other in adjacent) / len(adjacent)
+
+            layer.sort(key=barycenter)
+            for order, node in enumerate(layer):
+                position[node] = order / max(len(layer), 1)
+
+    for i in range(sweeps):
+        if i % 2 == 0:
+            sweep(layers[1:], predecessors)
+        else:
+            sweep(layers[-2::-1], successors)
+
+
+def layered_layout(model):
+    """Compute node positions and group label positions, see GraphModel."""
+    ranks = longest_path_ranks(model)
+    layers = [[] for _ in range(max(ranks, default=0) + 1)]
+    for i, rank in enumerate(ranks):
+        layers[rank].append(i)
+
+    predecessors = [[] for _ in model.nodes]
+    successors = [[] for _ in model.nodes]
+    for source, target in model.edges:
+        predecessors[target].append(source)
+        successors[source].append(target)
+    reduce_crossings(layers, predecessors, successors)
+
+    pos = [None] * len(model.nodes)
+    for rank, layer in enumerate(layers):
+        for order, node in enumerate(layer):
+            pos[node] = (rank * HORIZONTAL_SPACING, order * -VERTICAL_SPACING)
+
+    # Columns no longer correspond to groups, so the labels are stacked to
+    # the left of the first layer
+    label_pos = [(-HORIZONTAL_SPACING, i * -2 * VERTICAL_SPACING, "right") for i in range(len(model.groups))]
+    return pos, label_pos
+
+
+def cached_layered_layout(model, cache_path, version):
+    """layered_layout, read from cache_path when it was computed for this catalog version."""
+    try:
+        with open(cache_path, encoding="utf-8") as f:
+            cached = json.load(f)
+        if cached["version"] == version and cached["nodes"] == model.nodes:
+            return [tuple(p) for p in cached["pos"]], [tuple(p) for p in cached["label_pos"]]
+    except (OSError, ValueError, KeyError):
+        pass
+
+    pos, label_pos = layered_layout(model)
+    tmp_path = f"{cache_path}.{os.getpid()}.tmp"
+    try:
+        with open(tmp_path, "w", encoding="utf-8") as f:
+            json.dump({"version": version, "nodes": model.nodes, "pos": pos, "label_pos": label_pos}, f)
+        os.replace(tmp_path, cache_path)
+    except OSError as error:
+        print(f"Could not write layout cache {cache_path}: {error}")
+    return pos, label_pos
+
+
+def reuse_layout(previous, layout):
+    """A layout returning the positions of the previous model if the topology is unchanged.
+
+    Used when a catalog is reloaded: edits such as a renamed course or a new
+    credit threshold keep every node where it was, and only changes to the
+    courses, their groups or the prerequisite edges fall back to layout.
+    """
+    def cached(model):
+        if (model.nodes == previous.nodes and model.edges == previous.edges
+                and model.groups == previous.groups and model.node_group == previous.node_group):
+            return previous.pos, previous.label_pos
+        return layout(model)
+    return cached
@@ -1,8 +1,33 @@
+import argparse
+import base64
 import csv
+import functools
+import importlib.util
+import math
+import os
+import time
+import flask
 import networkx as nx
 import plotly.graph_objects as go
-from dash import Dash, dcc, html, Input, Output, ctx
+from dash import ClientsideFunction, Dash, dcc, html, Input, Output, Patch, State, ctx, no_update
+from array import array
+from html import escape
 from itertools import cycle
+from operator import itemgetter
+
+import metrics
+import snapshot
+import whatif
+from catalogs import CourseRegistry, default_programs, load_manifest
+from eligibility import CompletionState, PrerequisiteEngine, mask_to_flags
+from layout import cached_layered_layout, reuse_layout
+from reachability import LIMIT as REACHABILITY_LIMIT, ReachabilityIndex
+from sources import SourceError, SourceSync
+from spatial import GridIndex
+from validation import CatalogError, check_catalog
+from analytics import Analytics, AnalyticsWorker
+from hot_reload import LiveCatalog
+from figure_cache import FigureCache
 
 
 def generate_colors():
@@ -27,226 +52,1483 @@ class Course:
         return f"Course({self.class_number}, {self.name}, {self.group}, {self.credits}, {self.completed}, {self.prerequisites})"
 
 
-def parse_classes(file_path):
+class CatalogSchemaError(ValueError):
+    """Raised when a catalog file does not have the expected columns."""
+
+
+class LoadStats:
+    """Row count and wall time of one catalog file read."""
+
+    def __init__(self, file_path, rows, seconds):
+        self.file_path = file_path
+        self.rows = rows
+        self.seconds = seconds
+
+    @property
+    def rows_per_second(self):
+        return self.rows / self.seconds if self.seconds > 0 else float("inf")
+
+    def __repr__(self):
+        return f"{self.file_path}: {self.rows} rows in {self.seconds:.3f}s ({self.rows_per_second:,.0f} rows/s)"
+
+
+def resolve_columns(file_path, header, columns):
+    """Map the requested column names to their indices in the header."""
+    header = [name.strip() for name in header or []]
+    missing = [column for column in columns if column not in header]
+    if missing:
+        raise CatalogSchemaError(f"{file_path}: missing column(s) {', '.join(missing)}")
+    return [header.index(column) for column in columns]
+
+
+def read_rows(file_path, columns, delimiter=",", engine="csv", stats=None):
+    """Stream the requested columns of every row as stripped strings.
+
+    The header is validated and resolved to column indices once, so rows are
+    read by position instead of building a dict per row. engine="pyarrow"
+    reads the whole file with pyarrow's multithreaded CSV parser instead. If
+    stats is a list, a LoadStats entry is appended once the file is consumed.
+    """
+    start = time.perf_counter()
+    rows = 0
+    if engine == "pyarrow":
+        for rows, values in enumerate(_read_rows_pyarrow(file_path, columns, delimiter), 1):
+            yield values
+    else:
+        with open(file_path, newline='', encoding='utf-8') as csvfile:
+            reader = csv.reader(csvfile, delimiter=delimiter)
+            indices = resolve_columns(file_path, next(reader, None), columns)
+            width = max(indices) + 1
+            getter = itemgetter(*indices)
+            for row in reader:
+                if not row:
+                    continue
+                if len(row) < width:
+                    row = row + [""] * (width - len(row))
+                values = getter(row)
+                if len(indices) == 1:
+                    values = (values,)
+                rows += 1
+                yield [value.strip() for value in values]
+    if stats is not None:
+        stats.append(LoadStats(file_path, rows, time.perf_counter() - start))
+
+
+def _read_rows_pyarrow(file_path, columns, delimiter):
+    import pyarrow as pa
+    from pyarrow import csv as pa_csv
+
+    table = pa_csv.read_csv(
+        file_path,
+        parse_options=pa_csv.ParseOptions(delimiter=delimiter),
+        convert_options=pa_csv.ConvertOptions(
+            column_types={column: pa.string() for column in columns},
+            strings_can_be_null=False,
+        ),
+    )
+    table = table.rename_columns([name.strip() for name in table.column_names])
+    resolve_columns(file_path, table.column_names, columns)
+    for values in zip(*(table.column(column).to_pylist() for column in columns)):
+        yield [value.strip() for value in values]
+
+
+def parse_classes(file_path, engine="csv", stats=None, duplicates=None):
+    """Courses by number and group colors; course numbers seen twice are appended to duplicates."""
     courses = {}
     group_colors = {}
     color_generator = generate_colors()
 
-    with open(file_path, newline='', encoding='utf-8') as csvfile:
-        reader = csv.DictReader(csvfile)
-        for row in reader:
-            class_number = row["Class Number:"].strip()
-            name = row["Class Name:"].strip()
-            group = row["Group:"].strip()
-            credits = row["Credits:"].strip()
-            completed = row["Completed:"].strip()
-
-            if group not in group_colors:
-                group_colors[group] = next(color_generator)
+    columns = ["Class Number:", "Class Name:", "Group:", "Credits:", "Completed:"]
+    for class_number, name, group, credits, completed in read_rows(file_path, columns, engine=engine, stats=stats):
+        if group not in group_colors:
+            group_colors[group] = next(color_generator)
+        if duplicates is not None and class_number in courses:
+            duplicates.append(class_number)
 
-            courses[class_number] = Course(class_number, name, group, credits, completed)
+        courses[class_number] = Course(class_number, name, group, credits, completed)
 
     return courses, group_colors
 
 
-def parse_group_credits(file_path):
+def parse_group_credits(file_path, engine="csv", stats=None):
     group_credits = {}
-    with open(file_path, newline='', encoding='utf-8') as csvfile:
-        reader = csv.DictReader(csvfile)
-        for row in reader:
-            group = row["Group:"].strip()
-            credits_required = int(row["Credits Needed:"].strip())
-            group_credits[group] = credits_required
+    columns = ["Group:", "Credits Needed:"]
+    for group, credits_required in read_rows(file_path, columns, engine=engine, stats=stats):
+        group_credits[group] = int(credits_required)
     return group_credits
 
 
-def parse_prerequisites(file_path, courses):
-    with open(file_path, newline='', encoding='utf-8') as tsvfile:
-        reader = csv.DictReader(tsvfile, delimiter='\t')
-        for row in reader:
-            class_number = row["Class Number:"].strip()
-            prerequisites = row["Prerequisites:"].strip()
-            if class_number in courses:
-                prereq_groups = [
-                    [item.strip() for item in group.split("OR")]
-                    for group in prerequisites.split(",") if prerequisites
-                ]
-                courses[class_number].prerequisites.extend(prereq_groups)
-
-
-def create_figure(courses, group_colors, group_credits):
-    """Create the Plotly figure with the current state of the graph."""
-    G = nx.DiGraph()  # Create a directed graph
-    group_completed_credits = {group: 0 for group in group_credits}
-
-    # Add nodes and edges
-    for course in courses.values():
-        G.add_node(course.class_number, group=course.group, name=course.name, credits=course.credits, completed=course.completed)
-        if course.completed:
-            group_completed_credits[course.group] += course.credits
-        for prereq_group in course.prerequisites:
-            for prereq in prereq_group:
-                if prereq in courses:  # Add edge only if prerequisite exists
-                    G.add_edge(prereq, course.class_number)
+def parse_prerequisite_expression(prerequisites):
+    """Split "A OR B, C" into [[A, B], [C]]."""
+    return [
+        [item.strip() for item in group.split("OR")]
+        for group in prerequisites.split(",") if prerequisites
+    ]
+
+
+def parse_prerequisites(file_path, courses, engine="csv", stats=None):
+    columns = ["Class Number:", "Prerequisites:"]
+    for class_number, prerequisites in read_rows(file_path, columns, delimiter='\t', engine=engine, stats=stats):
+        if class_number in courses:
+            courses[class_number].prerequisites.extend(parse_prerequisite_expression(prerequisites))
+
+
+def snapshot_courses(rows):
+    """Mutable Course objects by number from the course rows of snapshot.read_snapshot."""
+    courses = {}
+    for class_number, name, group, credits, completed, prerequisites in rows:
+        course = Course(class_number, name, group, credits, "true" if completed else "false")
+        course.prerequisites = prerequisites
+        courses[class_number] = course
+    return courses
+
+
+def load_catalog(classes_file, groups_file, prereqs_file, engine="csv", stats=None, snapshot_path=None, digest=None,
+                 problems=None, strict=False):
+    """Load the catalog, going through a binary snapshot when a path is given.
+
+    The snapshot is used when its content hash matches the three source
+    files; otherwise the text files are parsed and the snapshot is rebuilt.
+    digest is the snapshot.source_hash of the files, if already computed.
+    Either way the catalog goes through validation.check_catalog (strict as
+    given): the text files are checked before the snapshot is written, and
+    the snapshot keeps the CatalogReport, which is enforced again when it is
+    loaded. If problems is a list, the report is appended.
+    """
+    if snapshot_path:
+        start = time.perf_counter()
+        if digest is None:
+            digest = snapshot.source_hash(classes_file, groups_file, prereqs_file)
+        cached = snapshot.read_snapshot(snapshot_path, digest)
+        if cached is not None:
+            rows, group_colors, group_credits, report = cached
+            courses = snapshot_courses(rows)
+            if stats is not None:
+                stats.append(LoadStats(snapshot_path, len(rows), time.perf_counter() - start))
+            if report is None:
+                report = check_catalog(courses, group_credits, strict=strict)
+            report.enforce(strict)
+            if problems is not None:
+                problems.append(report)
+            return courses, group_colors, group_credits
+
+    duplicates = []
+    courses, group_colors = parse_classes(classes_file, engine, stats, duplicates)
+    group_credits = parse_group_credits(groups_file, engine, stats)
+    parse_prerequisites(prereqs_file, courses, engine, stats)
+
+    # Only a catalog that passed is written, with its report
+    report = check_catalog(courses, group_credits, duplicates, strict)
+    if snapshot_path:
+        try:
+            snapshot.write_snapshot(snapshot_path, digest, courses, group_colors, group_credits, report)
+        except OSError as error:
+            print(f"Could not write catalog snapshot {snapshot_path}: {error}")
+
+    if problems is not None:
+        problems.append(report)
+    return courses, group_colors, group_credits
+
+
+def load_source_catalog(sync, snapshot_path, strict=False, problems=None):
+    """The catalog of a SourceSync's rows, checked like load_catalog.
 
-    # Define horizontal positions for each group
-    group_order = list(group_colors.keys())
-    group_positions = {group: i for i, group in enumerate(group_order)}
-    pos = {}
-    group_counters = {group: 0 for group in group_order}
+    It is also written to snapshot_path, the only copy on disk that the
+    analytics workers and the command line tools can load.
+    """
+    courses, group_colors, group_credits = sync.catalog()
+    report = check_catalog(courses, group_credits, strict=strict)
+    if problems is not None:
+        problems.append(report)
+    try:
+        snapshot.write_snapshot(snapshot_path, sync.digest(), courses, group_colors, group_credits, report)
+    except OSError as error:
+        print(f"Could not write catalog snapshot {snapshot_path}: {error}")
+    return courses, group_colors, group_credits
+
+
+def load_program_catalog(catalog_files, snapshot_path):
+    """load_catalog of a program's files, or the snapshot of a program read from a data source (no files)."""
+    if catalog_files is not None:
+        return load_catalog(*catalog_files, snapshot_path=snapshot_path)
+    cached = snapshot.read_snapshot(snapshot_path) if snapshot_path else None
+    if cached is None:
+        raise CatalogError(f"{snapshot_path}: no catalog snapshot of the data source; sync it first")
+    rows, group_colors, group_credits, report = cached
+    courses = snapshot_courses(rows)
+    if report is None:
+        check_catalog(courses, group_credits)
+    return courses, group_colors, group_credits
+
+
+def group_column_layout(model):
+    """Place each group in its own column, stacking courses in catalog order."""
+    group_positions = {group: i for i, group in enumerate(model.groups)}
+    group_counters = {group: 0 for group in model.groups}
     vertical_spacing = 3
 
-    for node in G.nodes():
-        group = G.nodes[node].get("group", "Unknown")
+    pos = []
+    for group in model.node_group:
         x = group_positions[group] * 5
         y = group_counters[group] * -vertical_spacing
         group_counters[group] += 1
-        pos[node] = (x, y)
+        pos.append((x, y))
 
-    # Create edge traces
+    # Group labels sit above their column
+    label_pos = [(group_positions[group] * 5, 2, "center") for group in model.groups]
+    return pos, label_pos
+
+
+class GraphModel:
+    """Immutable topology and static trace data of a parsed catalog.
+
+    Built once after the catalog is parsed; only course completion changes at
+    runtime, so figures are rendered from this model without touching
+    networkx again. layout is a function of the model returning the node
+    positions and the (x, y, xanchor) of each group label; it defaults to
+    group_column_layout. The courses must have been through
+    validation.check_catalog, as load_catalog does. With reachability=False
+    the reachability index is left to the caller (the benchmark times it on
+    its own).
+    """
+
+    def __init__(self, courses, group_colors, layout=group_column_layout, reachability=True):
+        G = nx.DiGraph()  # Create a directed graph
+
+        # Add nodes and edges; check_catalog has dropped the prerequisites
+        # that are not in the catalog
+        for course in courses.values():
+            G.add_node(course.class_number, group=course.group)
+            for prereq_group in course.prerequisites:
+                for prereq in prereq_group:
+                    G.add_edge(prereq, course.class_number)
+
+        self.graph = G
+        self.groups = list(group_colors.keys())
+        self.label_index = {group: i for i, group in enumerate(self.groups)}
+        self.nodes = list(G.nodes())
+        self.node_index = {node: i for i, node in enumerate(self.nodes)}
+
+        # Edges as (source index, target index); out_edges maps a node index
+        # to the indices of the edges leaving it
+        self.edges = [(self.node_index[u], self.node_index[v]) for u, v in G.edges()]
+        self.out_edges = [[] for _ in self.nodes]
+        for edge_index, (source, _) in enumerate(self.edges):
+            self.out_edges[source].append(edge_index)
+
+        # Direct prerequisites and direct dependents of every node, by index
+        self.predecessors = [[] for _ in self.nodes]
+        self.successors = [[] for _ in self.nodes]
+        for source, target in self.edges:
+            self.successors[source].append(target)
+            self.predecessors[target].append(source)
+
+        # Static node data
+        self.node_text = list(self.nodes)
+        self.node_hovertext = []
+        self.node_color = []
+        self.node_credits = []
+        self.node_group = []
+        for node in self.nodes:
+            course = courses[node]
+            self.node_hovertext.append(f"{node}: {course.name} ({course.credits} credits)")
+            self.node_color.append(group_colors.get(course.group, "gray"))
+            self.node_credits.append(course.credits)
+            self.node_group.append(course.group)
+
+        # Node and group label positions
+        with metrics.timed("layout"):
+            self.pos, self.label_pos = layout(self)
+        self.node_x = [x for x, _ in self.pos]
+        self.node_y = [y for _, y in self.pos]
+
+        # Every edge as an [x0, x1, None] segment, for the static edge trace
+        self.edge_x = []
+        self.edge_y = []
+        for source, target in self.edges:
+            self.edge_x.extend([self.pos[source][0], self.pos[target][0], None])
+            self.edge_y.extend([self.pos[source][1], self.pos[target][1], None])
+
+        # Compiled prerequisite expressions for eligibility checks
+        self.engine = PrerequisiteEngine(self, courses)
+
+        # Completion state from the Completed: column
+        self.default_completed = self.engine.completed_mask(self, courses)
+
+        # Transitive prerequisites and dependents of every node, or None
+        # for catalogs too large for the quadratic index
+        self.reachability = None
+        if reachability and len(self.nodes) <= REACHABILITY_LIMIT:
+            with metrics.timed("reachability"):
+                self.reachability = ReachabilityIndex(self)
+
+    @functools.cached_property
+    def spatial_index(self):
+        """Grid index of the node positions, for viewport queries."""
+        return GridIndex(self.pos)
+
+    @functools.cached_property
+    def search_text(self):
+        """Case-folded hover text of every node, for the course search."""
+        return [text.casefold() for text in self.node_hovertext]
+
+
+def group_label_text(group, group_completed_credits, group_credits):
+    return f"{group}<br>({group_completed_credits.get(group, 0)}/{group_credits.get(group, 0)} credits completed)"
+
+
+def node_marker_style(completed, eligible=False):
+    """Border color and size of a node marker.
+
+    Courses that are not taken yet but whose prerequisites are all met are
+    highlighted.
+    """
+    if completed:
+        return "gold", 30
+    if eligible:
+        return "deepskyblue", 25
+    return "black", 20
+
+
+def build_trace_arrays(model, state):
+    """Compute the per-state edge and node trace arrays.
+
+    All edges are drawn in red by a static trace; satisfied edges are drawn
+    over it in green. Every edge owns the same three-slot range in the green
+    trace, holding None while it is unsatisfied, so toggling a course only
+    rewrites the slots of its outgoing edges.
+    """
     satisfied_edge_x = []
     satisfied_edge_y = []
-    unsatisfied_edge_x = []
-    unsatisfied_edge_y = []
-
-    for edge in G.edges():
-        x0, y0 = pos[edge[0]]
-        x1, y1 = pos[edge[1]]
 
-        if courses[edge[0]].completed:
+    for source, target in model.edges:
+        if state.is_completed(source):
+            x0, y0 = model.pos[source]
+            x1, y1 = model.pos[target]
             satisfied_edge_x.extend([x0, x1, None])
             satisfied_edge_y.extend([y0, y1, None])
         else:
-            unsatisfied_edge_x.extend([x0, x1, None])
-            unsatisfied_edge_y.extend([y0, y1, None])
+            satisfied_edge_x.extend([None, None, None])
+            satisfied_edge_y.extend([None, None, None])
 
-    satisfied_edge_trace = go.Scatter(
-        x=satisfied_edge_x,
-        y=satisfied_edge_y,
-        line=dict(width=2, color="green"),
+    node_border_color = []
+    node_size = []
+
+    for i in range(len(model.nodes)):
+        border_color, size = node_marker_style(state.is_completed(i), state.is_eligible(i))
+        node_border_color.append(border_color)
+        node_size.append(size)
+
+    return {
+        "satisfied_edge_x": satisfied_edge_x,
+        "satisfied_edge_y": satisfied_edge_y,
+        "node_border_color": node_border_color,
+        "node_size": node_size,
+    }
+
+
+def typed_array(values):
+    """Encode numbers as a Plotly typed array (base64 float32, None as NaN).
+
+    Plotly.js 2.28+ decodes these natively; they are several times smaller
+    than the JSON list. Only used for arrays that are never patched, since a
+    Patch cannot address elements inside the encoded data.
+    """
+    data = array("f", (float("nan") if value is None else value for value in values))
+    return {"dtype": "f4", "bdata": base64.b64encode(data.tobytes()).decode("ascii")}
+
+
+def use_webgl(model, mode, threshold):
+    """Whether to draw with WebGL: mode is "on", "off" or "auto" (above threshold nodes + edges)."""
+    if mode == "auto":
+        return len(model.nodes) + len(model.edges) > threshold
+    return mode == "on"
+
+
+def visible_node_count(model, relayout_data):
+    """Number of nodes inside the zoomed region, or None when fully zoomed out."""
+    relayout_data = relayout_data or {}
+    try:
+        x0, x1 = sorted([relayout_data["xaxis.range[0]"], relayout_data["xaxis.range[1]"]])
+        y0, y1 = sorted([relayout_data["yaxis.range[0]"], relayout_data["yaxis.range[1]"]])
+    except KeyError:
+        return None
+    return len(model.spatial_index.query(x0, x1, y0, y1))
+
+
+def viewport(relayout_data, previous, bounds):
+    """The [x0, x1, y0, y1] region shown after a relayoutData event, None when zoomed out.
+
+    An event that sets only one axis keeps the other one from previous, or
+    from bounds when there is none; an event that sets no axis (a resize,
+    say) leaves previous as it is.
+    """
+    relayout_data = relayout_data or {}
+    if relayout_data.get("xaxis.autorange") or relayout_data.get("yaxis.autorange"):
+        return None
+    region = list(previous or bounds)
+    touched = False
+    for offset, axis in ((0, "xaxis"), (2, "yaxis")):
+        axis_range = relayout_data.get(f"{axis}.range")
+        if axis_range is None and f"{axis}.range[0]" in relayout_data and f"{axis}.range[1]" in relayout_data:
+            axis_range = [relayout_data[f"{axis}.range[0]"], relayout_data[f"{axis}.range[1]"]]
+        if axis_range is not None:
+            region[offset:offset + 2] = sorted(axis_range)
+            touched = True
+    return region if touched else previous
+
+
+def group_extent(model, group):
+    """The [x0, x1, y0, y1] region around a group's courses, with a margin."""
+    points = [position for position, node_group in zip(model.pos, model.node_group) if node_group == group]
+    xs = [x for x, _ in points]
+    ys = [y for _, y in points]
+    margin_x = (max(xs) - min(xs)) * 0.05 or 1.0
+    margin_y = (max(ys) - min(ys)) * 0.05 or 1.0
+    return [min(xs) - margin_x, max(xs) + margin_x, min(ys) - margin_y, max(ys) + margin_y]
+
+
+def use_lod(model, mode, threshold):
+    """Whether to draw by level of detail: mode is "on", "off" or "auto" (above threshold nodes)."""
+    if mode == "auto":
+        return len(model.nodes) > threshold
+    return mode == "on"
+
+
+def scatter_trace(webgl, **properties):
+    """A Scatter (or Scattergl) trace as a plain dict."""
+    return dict(type="scattergl" if webgl else "scatter", **properties)
+
+
+def make_figure(data, layout, validate=False):
+    """The figure as a plain dict, or as a validated go.Figure.
+
+    The traces and layout are written in Plotly's canonical form (no magic
+    underscores), so the dict is what go.Figure would produce; skipping the
+    property validation of the graph objects saves as much time as building
+    the arrays for large traces. validate is for debugging.
+    """
+    if validate:
+        return go.Figure(dict(data=data, layout=layout))
+    return dict(data=data, layout=layout)
+
+
+def create_figure(model, state, group_colors, group_credits, store=None, webgl=False, typed_arrays=False,
+                  validate=False):
+    """Create the Plotly figure with the current state of the graph.
+
+    When a columnar CourseStore is given, the per-state arrays come from it
+    instead of being built per node. With webgl the traces are drawn with
+    Scattergl and node labels start hidden; they are turned on by the zoom
+    callback once few enough nodes are in view. With typed_arrays the static
+    coordinates are sent as base64 typed arrays (needs plotly 6). The figure
+    is a plain dict unless validate is set, see make_figure.
+    """
+    encode = typed_array if typed_arrays else list
+    scatter = functools.partial(scatter_trace, webgl)
+    with metrics.timed("trace_arrays"):
+        if store is not None:
+            completed = store.flags(state.completed)
+            traces = store.trace_arrays(
+                completed, node_marker_style(True), node_marker_style(False, True), node_marker_style(False)
+            )
+            group_completed_credits = store.group_completed_credits(completed)
+        else:
+            traces = build_trace_arrays(model, state)
+            group_completed_credits = state.group_completed_credits
+
+    # Includes the validation of the graph objects in debug mode
+    figure_timer = metrics.Timer("figure")
+
+    # Create edge traces
+    edge_trace = scatter(
+        x=encode(model.edge_x),
+        y=encode(model.edge_y),
+        line=dict(width=2, color="red"),
         hoverinfo="none",
         mode="lines"
     )
 
-    unsatisfied_edge_trace = go.Scatter(
-        x=unsatisfied_edge_x,
-        y=unsatisfied_edge_y,
-        line=dict(width=2, color="red"),
+    satisfied_edge_trace = scatter(
+        x=traces["satisfied_edge_x"],
+        y=traces["satisfied_edge_y"],
+        line=dict(width=2, color="green"),
         hoverinfo="none",
         mode="lines"
     )
 
     # Create node traces
-    node_x = []
-    node_y = []
-    node_text = []
-    node_hovertext = []
-    node_color = []
-    node_border_color = []
-    node_size = []
-
-    for node in G.nodes():
-        x, y = pos[node]
-        node_x.append(x)
-        node_y.append(y)
-        group = G.nodes[node].get("group", "Unknown")
-        name = G.nodes[node].get("name", "Unknown")
-        credits = G.nodes[node].get("credits", 0)
-        completed = G.nodes[node].get("completed", False)
-
-        node_text.append(node)
-        node_hovertext.append(f"{node}: {name} ({credits} credits)")
-        node_color.append(group_colors.get(group, "gray"))
-
-        if completed:
-            node_border_color.append("gold")
-            node_size.append(30)
-        else:
-            node_border_color.append("black")
-            node_size.append(20)
-
-    node_trace = go.Scatter(
-        x=node_x,
-        y=node_y,
-        mode="markers+text",
-        text=node_text,
-        hovertext=node_hovertext,
+    node_trace = scatter(
+        x=encode(model.node_x),
+        y=encode(model.node_y),
+        mode="markers" if webgl else "markers+text",
+        text=model.node_text,
+        hovertext=model.node_hovertext,
         hoverinfo="text",
         textposition="top center",
         marker=dict(
-            size=node_size,
-            color=node_color,
+            size=traces["node_size"],
+            color=model.node_color,
             opacity=0.8,
             symbol="square",
-            line=dict(width=3, color=node_border_color)
+            line=dict(width=3, color=traces["node_border_color"])
         )
     )
 
-    group_labels = [
+    group_labels = group_annotations(model, group_completed_credits, group_credits)
+
+    fig = make_figure(
+        [edge_trace, satisfied_edge_trace, node_trace],
+        graph_layout("Interactive Course Dependency Graph with Reset Button", group_labels),
+        validate
+    )
+
+    figure_timer.stop()
+    return fig
+
+
+def group_annotations(model, group_completed_credits, group_credits):
+    """The group labels with their credit totals, in model.groups order."""
+    return [
         dict(
-            x=group_positions[group] * 5,
-            y=2,
-            text=f"{group}<br>({group_completed_credits.get(group, 0)}/{group_credits.get(group, 0)} credits completed)",
+            x=x,
+            y=y,
+            text=group_label_text(group, group_completed_credits, group_credits),
             showarrow=False,
             font=dict(size=16, color="black"),
-            xanchor="center", yanchor="bottom"
-        ) for group in group_colors
+            xanchor=xanchor, yanchor="bottom"
+        ) for group, (x, y, xanchor) in zip(model.groups, model.label_pos)
     ]
 
-    fig = go.Figure(
-        data=[satisfied_edge_trace, unsatisfied_edge_trace, node_trace],
-        layout=go.Layout(
-            title="Interactive Course Dependency Graph with Reset Button",
-            titlefont_size=20,
-            showlegend=False,
-            hovermode="closest",
-            margin=dict(b=0, l=0, r=0, t=50),
-            height=1000,
-            xaxis=dict(showgrid=False, zeroline=False, showticklabels=False),
-            yaxis=dict(showgrid=False, zeroline=False, showticklabels=False),
-            annotations=group_labels
+
+def graph_layout(title, annotations, meta=None):
+    """Layout shared by the full figure and the focus view."""
+    layout = dict(
+        title=dict(text=title, font=dict(size=20)),
+        showlegend=False,
+        hovermode="closest",
+        margin=dict(b=0, l=0, r=0, t=50),
+        height=1000,
+        xaxis=dict(showgrid=False, zeroline=False, showticklabels=False),
+        yaxis=dict(showgrid=False, zeroline=False, showticklabels=False),
+        annotations=annotations
+    )
+    if meta is not None:
+        layout["meta"] = meta
+    return layout
+
+
+def focus_nodes(model, center, depth=None):
+    """Indices of a course and of its ancestors and descendants.
+
+    Prerequisites and dependents are followed for at most depth edges each
+    way, or to the end when depth is None; siblings (other dependents of an
+    ancestor) are not included.
+    """
+    if depth is None and model.reachability is not None:
+        return set_bits(model.reachability.neighborhood(center), len(model.nodes))
+    selected = {center}
+    for adjacency in (model.predecessors, model.successors):
+        seen = {center}
+        frontier = [center]
+        level = 0
+        while frontier and (depth is None or level < depth):
+            next_frontier = []
+            for node in frontier:
+                for neighbor in adjacency[node]:
+                    if neighbor not in seen:
+                        seen.add(neighbor)
+                        next_frontier.append(neighbor)
+            frontier = next_frontier
+            level += 1
+        selected |= seen
+    return sorted(selected)
+
+
+def search_courses(model, text, limit):
+    """Indices of at most limit courses whose number or name contains text, ignoring case."""
+    text = text.casefold()
+    matches = []
+    for i, searched in enumerate(model.search_text):
+        if text in searched:
+            matches.append(i)
+            if len(matches) == limit:
+                break
+    return matches
+
+
+def subset_traces(model, state, nodes, webgl=False, center=None, touching=False, labels=True):
+    """Edge and node traces of only the given courses, in the trace order of create_figure.
+
+    Edges are drawn between the given courses and, with touching, also to
+    and from the courses outside of them. center is drawn as a diamond.
+    """
+    scatter = functools.partial(scatter_trace, webgl)
+    keep = set(nodes)
+
+    # Create edge traces
+    edge_x = []
+    edge_y = []
+    satisfied_edge_x = []
+    satisfied_edge_y = []
+
+    def add_edge(source, target):
+        segment_x = [model.pos[source][0], model.pos[target][0], None]
+        segment_y = [model.pos[source][1], model.pos[target][1], None]
+        edge_x.extend(segment_x)
+        edge_y.extend(segment_y)
+        if state.is_completed(source):
+            satisfied_edge_x.extend(segment_x)
+            satisfied_edge_y.extend(segment_y)
+
+    for i in nodes:
+        for edge_index in model.out_edges[i]:
+            source, target = model.edges[edge_index]
+            if touching or target in keep:
+                add_edge(source, target)
+        if touching:
+            for source in model.predecessors[i]:
+                if source not in keep:
+                    add_edge(source, i)
+
+    edge_trace = scatter(x=edge_x, y=edge_y, line=dict(width=2, color="red"), hoverinfo="none", mode="lines")
+    satisfied_edge_trace = scatter(
+        x=satisfied_edge_x, y=satisfied_edge_y, line=dict(width=2, color="green"), hoverinfo="none", mode="lines"
+    )
+
+    # Create node traces
+    styles = [node_marker_style(state.is_completed(i), state.is_eligible(i)) for i in nodes]
+    node_trace = scatter(
+        x=[model.node_x[i] for i in nodes],
+        y=[model.node_y[i] for i in nodes],
+        mode="markers+text" if labels else "markers",
+        text=[model.node_text[i] for i in nodes],
+        hovertext=[model.node_hovertext[i] for i in nodes],
+        hoverinfo="text",
+        textposition="top center",
+        marker=dict(
+            size=[size for _, size in styles],
+            color=[model.node_color[i] for i in nodes],
+            opacity=0.8,
+            symbol=["diamond" if i == center else "square" for i in nodes],
+            line=dict(width=3, color=[border_color for border_color, _ in styles])
+        )
+    )
+    return [edge_trace, satisfied_edge_trace, node_trace]
+
+
+def create_focus_figure(model, state, nodes, center, webgl=False, validate=False):
+    """Create a figure of only the given courses and the edges between them.
+
+    Used for the focus view, so its cost is in the size of the neighborhood
+    rather than of the catalog. Courses keep their positions from the full
+    layout and the traces are in the same order as in create_figure; group
+    labels are left out. layout.meta.focus names the focused course, which
+    tells the browser-side toggle to leave the figure to the server.
+    """
+    traces = subset_traces(model, state, nodes, webgl, center)
+    node = model.nodes[center]
+    with metrics.timed("figure"):
+        return make_figure(
+            traces,
+            graph_layout(f"Focus on {node}: {len(nodes)} of {len(model.nodes)} courses", [], {"focus": node}),
+            validate
+        )
+
+
+def create_summary_figure(model, state, nodes, group_colors, group_credits, webgl=False, validate=False):
+    """Create a figure with one node per group, standing for the given courses of that group.
+
+    A group's node sits at the center of its courses, is sized by their
+    number and shows the group's credit totals; edges join groups with a
+    prerequisite between them. customdata holds the group name, so a click
+    can zoom into the group.
+    """
+    scatter = functools.partial(scatter_trace, webgl)
+    keep = nodes if isinstance(nodes, range) else set(nodes)
+    members = {}
+    for i in nodes:
+        members.setdefault(model.node_group[i], []).append(i)
+    groups = [group for group in model.groups if group in members]
+
+    # Centers, offered credits and courses open to take per group
+    centers = {}
+    hovertext = []
+    for group in groups:
+        indices = members[group]
+        centers[group] = (
+            sum(model.node_x[i] for i in indices) / len(indices), sum(model.node_y[i] for i in indices) / len(indices)
+        )
+        offered = sum(model.node_credits[i] for i in indices)
+        eligible = sum(1 for i in indices if state.is_eligible(i) and not state.is_completed(i))
+        hovertext.append(
+            f"{group}: {len(indices)} courses ({offered} credits) here, {eligible} of them eligible now"
+        )
+
+    # Create edge traces, once per pair of groups
+    pairs = set()
+    for i in nodes:
+        group = model.node_group[i]
+        for target in model.successors[i]:
+            if target in keep and model.node_group[target] != group:
+                pairs.add((group, model.node_group[target]))
+    edge_x = []
+    edge_y = []
+    for source, target in sorted(pairs):
+        edge_x.extend([centers[source][0], centers[target][0], None])
+        edge_y.extend([centers[source][1], centers[target][1], None])
+    edge_trace = scatter(x=edge_x, y=edge_y, line=dict(width=2, color="red"), hoverinfo="none", mode="lines")
+    satisfied_edge_trace = scatter(x=[], y=[], line=dict(width=2, color="green"), hoverinfo="none", mode="lines")
+
+    # Create node traces; groups with enough credits get a gold border
+    largest = max((len(indices) for indices in members.values()), default=1)
+    completed_credits = state.group_completed_credits
+    node_trace = scatter(
+        x=[centers[group][0] for group in groups],
+        y=[centers[group][1] for group in groups],
+        mode="markers+text",
+        text=[group_label_text(group, completed_credits, group_credits) for group in groups],
+        hovertext=hovertext,
+        hoverinfo="text",
+        customdata=groups,
+        textposition="top center",
+        marker=dict(
+            size=[20 + 40 * math.sqrt(len(members[group]) / largest) for group in groups],
+            color=[group_colors.get(group, "gray") for group in groups],
+            opacity=0.8,
+            symbol="circle",
+            line=dict(width=3, color=[
+                "gold" if completed_credits.get(group, 0) >= group_credits.get(group, 0) else "black"
+                for group in groups
+            ])
         )
     )
 
+    title = f"{len(nodes)} courses in {len(groups)} groups: click a group or zoom in to see its courses"
+    with metrics.timed("figure"):
+        return make_figure(
+            [edge_trace, satisfied_edge_trace, node_trace], graph_layout(title, [], {"lod": "summary"}), validate
+        )
+
+
+def create_lod_figure(model, state, group_colors, group_credits, view, limit, label_limit, webgl=False,
+                      validate=False):
+    """Create the figure of the region view ([x0, x1, y0, y1], None for everything).
+
+    A region holding at most limit courses is drawn course by course, with
+    labels up to label_limit courses and the edges leaving the region;
+    otherwise its courses are summarized per group. layout.meta.lod is
+    "summary" or "detail".
+    """
+    with metrics.timed("viewport_query"):
+        nodes = model.spatial_index.query(*view) if view is not None else range(len(model.nodes))
+    if view is None or len(nodes) > limit:
+        fig = create_summary_figure(model, state, nodes, group_colors, group_credits, webgl, validate)
+    else:
+        traces = subset_traces(model, state, nodes, webgl, touching=True, labels=len(nodes) <= label_limit)
+        group_labels = group_annotations(model, state.group_completed_credits, group_credits)
+        title = f"{len(nodes)} of {len(model.nodes)} courses in view"
+        with metrics.timed("figure"):
+            fig = make_figure(traces, graph_layout(title, group_labels, {"lod": "detail"}), validate)
+    if view is not None:
+        # Keep the region that was asked for instead of fitting the traces
+        fig["layout"]["xaxis"]["range"] = view[:2]
+        fig["layout"]["yaxis"]["range"] = view[2:]
     return fig
 
 
-def main():
-    # File paths
-    classes_file = "./mnt/data/classes.csv"
-    groups_file = "./mnt/data/groups.csv"
-    prereqs_file = "./mnt/data/prereqs.tsv"
+def patch_figure(model, state, group_credits, restyled, toggled, groups):
+    """Build a partial figure update after some courses changed state.
+
+    restyled are the courses whose completion or eligibility changed,
+    toggled the ones whose completion changed and groups the groups whose
+    totals changed. Only their markers, the edges leaving the toggled
+    courses and those group labels are sent; everything else stays as it is
+    in the browser.
+    """
+    patched = Patch()
+
+    # Show or hide the outgoing edges in the satisfied trace
+    for node_index in toggled:
+        completed = state.is_completed(node_index)
+        for edge_index in model.out_edges[node_index]:
+            source, target = model.edges[edge_index]
+            for offset, (x, y) in enumerate([model.pos[source], model.pos[target]]):
+                slot = 3 * edge_index + offset
+                patched["data"][1]["x"][slot] = x if completed else None
+                patched["data"][1]["y"][slot] = y if completed else None
+
+    # Restyle the courses whose completion or eligibility changed
+    for i in restyled:
+        border_color, size = node_marker_style(state.is_completed(i), state.is_eligible(i))
+        patched["data"][2]["marker"]["size"][i] = size
+        patched["data"][2]["marker"]["line"]["color"][i] = border_color
+
+    # Refresh the labels of the affected groups
+    for group in groups:
+        patched["layout"]["annotations"][model.label_index[group]]["text"] = group_label_text(
+            group, state.group_completed_credits, group_credits
+        )
+
+    return patched
+
+
+def patch_toggle(model, state, group_credits, changed):
+    """patch_figure for the list returned by CompletionState.toggle."""
+    toggled = changed[0]
+    return patch_figure(model, state, group_credits, changed, [toggled], [model.node_group[toggled]])
+
 
-    # Parse course details and groups
-    courses, group_colors = parse_classes(classes_file)
-    group_credits = parse_group_credits(groups_file)
-    parse_prerequisites(prereqs_file, courses)
+def set_bits(mask, size):
+    """Indices of the set bits of a bitmask."""
+    flags = mask_to_flags(mask, size)
+    indices = []
+    i = flags.find("1")
+    while i != -1:
+        indices.append(i)
+        i = flags.find("1", i + 1)
+    return indices
 
-    original_courses = {key: course.completed for key, course in courses.items()}
 
-    app = Dash(__name__)
+def patch_transition(model, old, new, group_credits):
+    """patch_figure taking the browser from state old to state new."""
+    size = len(model.nodes)
+    toggled = set_bits(old.completed ^ new.completed, size)
+    restyled = set_bits((old.completed ^ new.completed) | (old.eligible ^ new.eligible), size)
+    groups = [group for group in model.groups if old.group_completed_credits[group] != new.group_completed_credits[group]]
+    return patch_figure(model, new, group_credits, restyled, toggled, groups)
 
-    app.layout = html.Div([
-        dcc.Graph(id="course-graph", config={"displayModeBar": False}),
-        html.Button("Reset", id="reset-button", n_clicks=0),
-    ])
+
+def client_catalog(model, group_credits, default_state):
+    """Static catalog data for the browser-side toggle in assets/course_chart.js.
+
+    Shipped once per page load; it holds what CompletionState.toggle and
+    patch_figure need: positions, edges, prerequisite groups, reverse
+    adjacency, credits and marker styles.
+    """
+    return {
+        "index": model.node_index,
+        "pos": model.pos,
+        "edges": model.edges,
+        "out_edges": model.out_edges,
+        "requirements": model.engine.alternatives,
+        "dependents": model.engine.dependents,
+        "credits": model.node_credits,
+        "group": [model.label_index[group] for group in model.node_group],
+        "groups": model.groups,
+        "group_credits": [group_credits.get(group, 0) for group in model.groups],
+        "styles": {
+            "completed": node_marker_style(True),
+            "eligible": node_marker_style(False, True),
+            "pending": node_marker_style(False),
+        },
+        "default_state": default_state,
+    }
+
+
+DEFAULT_CREDIT_CAP = 16
+SEARCH_LIMIT = 50
+
+
+def plan_summary(result):
+    """Render an Analytics result as a short list of terms."""
+    if "error" in result:
+        return [html.P(f"Could not compute the plan ({result['error']}); it is retried shortly")]
+    children = [html.H3(f"Plan: {len(result['terms'])} term(s) to graduation")]
+    if result["critical_path"]:
+        children.append(html.P("Critical path: " + " \u2192 ".join(result["critical_path"])))
+    children.append(html.Ol([html.Li(", ".join(term)) for term in result["terms"]]))
+    for group, credits in result["shortfall"].items():
+        children.append(html.P(f"{group}: {credits} credits cannot be reached with this catalog"))
+    return children
+
+
+def parse_args(argv=None):
+    parser = argparse.ArgumentParser(description="Interactive course dependency chart")
+    parser.add_argument(
+        "--programs", metavar="MANIFEST",
+        help="JSON manifest of the programs to host (default: the single catalog in ./mnt/data)"
+    )
+    parser.add_argument(
+        "--reload-interval", type=float, default=2.0, metavar="SECONDS",
+        help="poll the catalog files (or data source snapshots) for changes this often and reload them (0 disables)"
+    )
+    parser.add_argument(
+        "--source-interval", type=float, default=300.0, metavar="SECONDS",
+        help="pull the programs read from a data source this often, from one process per host"
+    )
+    parser.add_argument(
+        "--focus-depth", type=int, default=2,
+        help="initial number of prerequisite/dependent levels shown in the focus view (empty: all)"
+    )
+    parser.add_argument(
+        "--figure-cache-mb", type=float, default=64,
+        help="MiB of serialized figures kept for repeated completion states, per server worker (0 disables)"
+    )
+    parser.add_argument(
+        "--validate-figures", action="store_true",
+        help="build figures as validated plotly graph objects instead of plain dicts (for debugging)"
+    )
+    parser.add_argument(
+        "--otel", action="store_true",
+        help="emit OpenTelemetry spans for the load and render stages (needs opentelemetry-api)"
+    )
+    parser.add_argument(
+        "--columnar", action="store_true",
+        help="render from a numpy columnar course store (for large catalogs)"
+    )
+    parser.add_argument(
+        "--layout", choices=["groups", "layered"], default="groups",
+        help="one column per group, or layers by prerequisite depth (cached in layout.json)"
+    )
+    parser.add_argument(
+        "--webgl", choices=["auto", "on", "off"], default="auto",
+        help="draw with WebGL (Scattergl); auto switches above --webgl-threshold"
+    )
+    parser.add_argument(
+        "--webgl-threshold", type=int, default=2000,
+        help="node + edge count above which auto mode uses WebGL"
+    )
+    parser.add_argument(
+        "--label-limit", type=int, default=300,
+        help="in WebGL mode, show node labels once at most this many nodes are in view"
+    )
+    parser.add_argument(
+        "--lod", choices=["auto", "on", "off"], default="auto",
+        help="draw by level of detail: group summaries when zoomed out, the courses in view when zoomed in;"
+             " auto switches above --lod-threshold"
+    )
+    parser.add_argument(
+        "--lod-threshold", type=int, default=5000,
+        help="course count above which auto mode draws by level of detail"
+    )
+    parser.add_argument(
+        "--lod-limit", type=int, default=1000,
+        help="in level-of-detail mode, draw the courses one by one once at most this many are in view"
+    )
+    parser.add_argument(
+        "--analytics-workers", type=int, default=1,
+        help="processes computing plans in the background (0 computes them in the request)"
+    )
+    parser.add_argument(
+        "--batch-workers", type=int,
+        help="processes evaluating what-if batches (default: one per CPU, under gunicorn each worker's share; "
+             "0 evaluates them in the request)"
+    )
+    parser.add_argument(
+        "--loader", choices=["csv", "pyarrow"], default="csv",
+        help="CSV reader used to load the catalog files"
+    )
+    parser.add_argument(
+        "--no-snapshot", action="store_true",
+        help="always parse the text files instead of using the binary catalog snapshot"
+    )
+    parser.add_argument(
+        "--strict-catalog", action="store_true",
+        help="refuse a catalog with dangling prerequisites, duplicate courses or groups missing from groups.csv"
+    )
+    parser.add_argument(
+        "--load-stats", action="store_true",
+        help="print the load throughput of every catalog file"
+    )
+    parser.add_argument(
+        "--server-toggle", action="store_true",
+        help="handle clicks and resets on the server instead of in the browser"
+    )
+    parser.add_argument(
+        "--typed-arrays", action="store_true",
+        help="send static coordinates as base64 typed arrays (needs plotly>=6)"
+    )
+    parser.add_argument(
+        "--compress", action="store_true",
+        help="gzip responses with Flask-Compress (the figure JSON compresses well)"
+    )
+    parser.add_argument(
+        "--assets-cdn", metavar="URL",
+        help="serve Dash's JavaScript from its CDN and the assets folder from URL"
+    )
+    args = parser.parse_args(argv)
+
+    # Options needing a package from requirements-extras.txt fail here
+    # rather than on the first request
+    for enabled, option, module, package in [
+        (args.columnar, "--columnar", "numpy", "numpy"),
+        (args.loader == "pyarrow", "--loader pyarrow", "pyarrow", "pyarrow"),
+        (args.compress, "--compress", "flask_compress", "flask-compress"),
+    ]:
+        if enabled and importlib.util.find_spec(module) is None:
+            parser.error(f"{option} needs the {package} package (see requirements-extras.txt)")
+    return args
+
+
+class ProgramCatalog:
+    """One program's catalog with the graph model and data derived from it.
+
+    Course records go through the shared registry, so programs loaded into
+    the same process hold only their own group membership and thresholds.
+    A ProgramCatalog is never modified; a reload (see hot_reload.py) builds
+    a new one, passing the previous model so its layout can be reused.
+    digest is the snapshot.source_hash of the catalog files and file_stats
+    their (mtime, size) from before they were read. A program read from a
+    data source has the SourceSync.digest of its rows instead, no
+    file_stats, and its source_sync, which later versions share.
+    """
+
+    def __init__(self, args, program, courses, group_colors, group_credits, digest, file_stats, previous=None,
+                 source_sync=None):
+        self.program = program
+        # The snapshot is the only copy of a data source's catalog on disk
+        if args.no_snapshot and program.source is None:
+            self.snapshot_file = None
+        else:
+            self.snapshot_file = program.cache_file("catalog.snapshot")
+        self.source_sync = source_sync
+        self.digest = digest
+        self.version = digest.hex()[:16]
+        self.file_stats = file_stats
+        self.courses = courses
+        self.group_colors = group_colors
+        self.group_credits = group_credits
+
+        # The topology never changes at runtime, so build it once
+        if args.layout == "layered":
+            layout = functools.partial(
+                cached_layered_layout, cache_path=program.cache_file("layout.json"), version=digest.hex()
+            )
+        else:
+            layout = group_column_layout
+        if previous is not None:
+            layout = reuse_layout(previous, layout)
+        with metrics.timed("graph_model"):
+            self.model = GraphModel(courses, group_colors, layout)
+        self.store = None
+        if args.columnar:
+            from course_store import CourseStore
+            self.store = CourseStore(self.model, courses, group_colors, group_credits)
+        self.webgl = use_webgl(self.model, args.webgl, args.webgl_threshold)
+        self.lod = use_lod(self.model, args.lod, args.lod_threshold)
+
+        # Completion state lives in the browser session, one bitmask per user,
+        # so the server holds no per-user state and any worker can answer
+        self.default_state = self.state_json(CompletionState(self.model, self.model.default_completed))
+
+    @classmethod
+    def load(cls, args, program, registry):
+        """Load a program's catalog, through its snapshot unless disabled."""
+        if program.source is not None:
+            return cls.load_source(args, program, registry)
+        file_stats = catalog_file_stats(program.catalog_files)
+        digest = snapshot.source_hash(*program.catalog_files)
+        snapshot_file = None if args.no_snapshot else program.cache_file("catalog.snapshot")
+
+        # Parse course details and groups
+        load_stats = []
+        problems = []
+        with metrics.timed("load_catalog"):
+            catalog = registry.share(*load_catalog(
+                *program.catalog_files, args.loader, load_stats, snapshot_file, digest, problems, args.strict_catalog
+            ))
+        if args.load_stats:
+            for stats in load_stats:
+                print(stats)
+        for line in problems[0].lines():
+            print(f"{program.id}: {line}")
+        return cls(args, program, *catalog, digest, file_stats)
+
+    @classmethod
+    def load_source(cls, args, program, registry):
+        """Load a program's catalog from its data source, fetching what changed since the last run."""
+        sync = SourceSync(program.source, program.cache_file("source.json"))
+        problems = []
+        with metrics.timed("load_catalog"):
+            start = time.perf_counter()
+            try:
+                changed = sync.pull()
+            except (SourceError, OSError) as error:
+                # Start from the rows of the last run rather than not at all
+                if not sync.rows["courses"]:
+                    raise
+                print(f"{program.id}: could not sync its source ({error}); using the catalog synced last")
+                changed = 0
+            finally:
+                # Closed before a WSGI server forks; the process that pulls
+                # next opens a pool of its own
+                sync.close()
+            seconds = time.perf_counter() - start
+            catalog = registry.share(*load_source_catalog(
+                sync, program.cache_file("catalog.snapshot"), args.strict_catalog, problems
+            ))
+        if args.load_stats:
+            print(f"{program.id}: {changed} changed row(s) synced in {seconds:.3f}s")
+        for line in problems[0].lines():
+            print(f"{program.id}: {line}")
+        return cls(args, program, *catalog, sync.digest(), None, source_sync=sync)
+
+    def state_json(self, state):
+        """CompletionState.to_json, tagged with the catalog version it indexes."""
+        data = state.to_json()
+        data["version"] = self.version
+        return data
+
+
+def catalog_file_stats(file_paths):
+    """(mtime, size) of each file, to notice edits without reading them."""
+    stats = []
+    for file_path in file_paths:
+        stat = os.stat(file_path)
+        stats.append((stat.st_mtime_ns, stat.st_size))
+    return stats
+
+
+def create_app(args, precompute=True):
+    """Load every program's catalog and build one Dash app per program.
+
+    Everything expensive happens here (see wsgi.py for forking servers).
+    precompute queues the default states' plans right away, which should be
+    skipped before forking.
+
+    The apps share one Flask server, which is app.server of the returned
+    (first) app. A single program is served at /; with a manifest each
+    program is served at /<id>/ and / lists them.
+    """
+    programs = load_manifest(args.programs) if args.programs else default_programs()
+    registry = CourseRegistry()
+    catalogs = [ProgramCatalog.load(args, program, registry) for program in programs]
+
+    # Plans and what-if batches are computed off the request thread, by
+    # pools shared by all programs; start on the default states
+    analytics = AnalyticsWorker(
+        {catalog.program.id: (catalog.program.catalog_files, catalog.snapshot_file) for catalog in catalogs},
+        {catalog.program.id: (catalog.version, Analytics(catalog.model, catalog.group_credits)) for catalog in catalogs},
+        args.analytics_workers, batch_workers=args.batch_workers
+    )
+    if precompute:
+        for catalog in catalogs:
+            analytics.precompute(catalog.program.id, catalog.default_state["completed"], DEFAULT_CREDIT_CAP)
+
+    # Edits to the catalog files are picked up without a restart
+    live_catalogs = [
+        LiveCatalog(args, catalog, registry, analytics, args.reload_interval, pull_interval=args.source_interval)
+        for catalog in catalogs
+    ]
+
+    # Repeated completion states are served from rendered figures
+    figures = FigureCache(int(args.figure_cache_mb * 2 ** 20))
+
+    server = flask.Flask(__name__)
+    if args.compress:
+        from flask_compress import Compress
+        Compress(server)
+    # Installed after Compress, so response sizes are measured uncompressed
+    metrics.install(server)
+    # Registered last so that it runs first: Compress and the metrics see
+    # the responses with the figures in
+    figures.install(server)
+    if args.otel and not metrics.enable_tracing():
+        print("--otel needs the opentelemetry-api package; tracing is off")
+
+    if len(live_catalogs) == 1:
+        return create_program_app(args, live_catalogs[0], server, analytics, figures, "/", [])
+
+    links = [(program.title, f"/{program.id}/") for program in programs]
+    apps = [
+        create_program_app(args, live, server, analytics, figures, f"/{live.catalog.program.id}/", links)
+        for live in live_catalogs
+    ]
+
+    @server.route("/")
+    def program_index():
+        items = "".join(f'<li><a href="{href}">{escape(title)}</a></li>' for title, href in links)
+        return f"<!DOCTYPE html><title>Programs</title><h1>Programs</h1><ul>{items}</ul>"
+
+    return apps[0]
+
+
+def create_program_app(args, live, server, analytics, figures, url_base_pathname, links):
+    """Build the Dash app of one program, mounted on server at url_base_pathname.
+
+    Every callback and page load reads the program's catalog from live once,
+    so a hot reload takes effect on the next request. Full figures go
+    through the FigureCache figures. The program's batch what-if API is
+    served at api/whatif below url_base_pathname.
+    """
+    program = live.catalog.program
+
+    options = dict(server=server, url_base_pathname=url_base_pathname, title=program.title)
+    if args.assets_cdn:
+        options.update(serve_locally=False, assets_external_path=args.assets_cdn)
+    app = Dash(__name__, **options)
+    whatif.install(server, f"{url_base_pathname}api/whatif", f"whatif_{program.id}", live, analytics)
+
+    # Session storage is per origin and keyed by component id, so every
+    # program keeps its completion state under its own id
+    state_id = f"completion-state-{program.id}"
+
+    def serve_layout():
+        catalog = live.get()
+        # A level-of-detail catalog is drawn by the server, see update_viewport
+        catalog_data = None if args.server_toggle or catalog.lod else client_catalog(
+            catalog.model, catalog.group_credits, catalog.default_state
+        )
+        return html.Div([
+            html.Nav([html.A(title, href=href, style={"marginRight": "1em"}) for title, href in links], hidden=not links),
+            dcc.Graph(id="course-graph", config={"displayModeBar": False}),
+            html.Button("Reset", id="reset-button", n_clicks=0),
+            # The options follow the search, see update_focus_options
+            html.Label(["Focus on: ", dcc.Dropdown(
+                id="focus-course", clearable=True, placeholder="All courses (type to search)", options=[],
+                style={"width": "30em", "display": "inline-block", "verticalAlign": "middle"}
+            )]),
+            html.Label([" Depth: ", dcc.Input(id="focus-depth", type="number", min=1, value=args.focus_depth)]),
+            dcc.Store(id=state_id, storage_type="session"),
+            dcc.Store(id="catalog-data", data=catalog_data),
+            dcc.Store(id="lod-view"),
+            html.Label(["Credits per term: ", dcc.Input(id="credit-cap", type="number", min=1, value=DEFAULT_CREDIT_CAP)]),
+            html.Div(id="plan"),
+            dcc.Interval(id="plan-poll", interval=250, disabled=True),
+        ])
+
+    app.layout = serve_layout
+
+    def full_figure(catalog, state):
+        return figures.get(
+            (program.id, catalog.version, format(state.completed, "x"), None),
+            lambda: create_figure(
+                catalog.model, state, catalog.group_colors, catalog.group_credits, catalog.store, catalog.webgl,
+                args.typed_arrays, args.validate_figures
+            )
+        )
+
+    def lod_figure(catalog, state, view):
+        return create_lod_figure(
+            catalog.model, state, catalog.group_colors, catalog.group_credits, view, args.lod_limit, args.label_limit,
+            catalog.webgl, args.validate_figures
+        )
+
+    def overview_figure(catalog, state):
+        """The figure of the whole catalog: every course, or the group summary in level-of-detail mode."""
+        if not catalog.lod:
+            return full_figure(catalog, state)
+        return figures.get(
+            (program.id, catalog.version, format(state.completed, "x"), "lod"), lambda: lod_figure(catalog, state, None)
+        )
+
+    if args.server_toggle:
+        graph_inputs = [Input("course-graph", "clickData"), Input("reset-button", "n_clicks")]
+    else:
+        # Toggles and resets run in the browser on the catalog-data store
+        # (assets/course_chart.js); the server only renders the page load,
+        # fired by ids that never change so that the store is not uploaded
+        graph_inputs = [Input("course-graph", "id"), Input("reset-button", "id")]
+        app.clientside_callback(
+            ClientsideFunction(namespace="course_chart", function_name="toggle"),
+            [Output("course-graph", "figure", allow_duplicate=True),
+             Output(state_id, "data", allow_duplicate=True),
+             Output("focus-course", "value", allow_duplicate=True)],
+            [Input("course-graph", "clickData"), Input("reset-button", "n_clicks")],
+            [State(state_id, "data"), State("course-graph", "figure"), State("catalog-data", "data")],
+            prevent_initial_call=True
+        )
 
     @app.callback(
-        Output("course-graph", "figure"),
-        [Input("course-graph", "clickData"), Input("reset-button", "n_clicks")]
+        [Output("course-graph", "figure"), Output(state_id, "data"), Output("focus-course", "value")],
+        graph_inputs,
+        [State(state_id, "data"), State("focus-course", "value")]
     )
-    def update_graph(click_data, reset_clicks):
+    def update_graph(click_data, reset_clicks, state_data, focus):
+        start = time.perf_counter()
+        action, result = render_graph(click_data, state_data, focus)
+        metrics.CALLBACK_SECONDS.observe(time.perf_counter() - start, callback="update_graph", action=action)
+        return result
+
+    def render_graph(click_data, state_data, focus):
+        """update_graph, returning what it did ("load", "click", "reset" or "focus") with the outputs."""
+        # The full figure is only sent on page load; afterwards the browser
+        # keeps it and every change is a patch
         triggered_id = ctx.triggered_id
+        with metrics.timed("restore_state"):
+            catalog, state = live.restore(state_data)
+        model = catalog.model
+        if focus and triggered_id in ("course-graph", "reset-button"):
+            # In the focus view a click moves the focus and update_focus
+            # handles the reset
+            node_id = click_data["points"][0].get("text") if click_data else None
+            if triggered_id == "course-graph" and node_id in model.node_index:
+                return "focus", (no_update, no_update, node_id)
+            return "focus", (no_update, no_update, no_update)
+        if catalog.lod and triggered_id in ("course-graph", "reset-button"):
+            # Counted and handled by update_viewport
+            return "lod", (no_update, no_update, no_update)
+        if triggered_id == "course-graph":
+            metrics.CLICKS.inc(program=program.id)
+        elif triggered_id == "reset-button":
+            metrics.RESETS.inc(program=program.id)
+        # A state from before a reload means the browser still shows the
+        # old catalog, so it gets a full figure instead of a patch
+        stale = state_data is not None and state_data.get("version") != catalog.version
         if triggered_id == "reset-button":
-            for key in courses:
-                courses[key].completed = original_courses[key]
+            reset = CompletionState.from_json(model, catalog.default_state)
+            if not stale:
+                with metrics.timed("patch"):
+                    patched = patch_transition(model, state, reset, catalog.group_credits)
+                return "reset", (patched, catalog.default_state, no_update)
+            state = reset
         elif triggered_id == "course-graph" and click_data:
-            node_id = click_data["points"][0]["text"]
-            if node_id in courses:
-                courses[node_id].completed = not courses[node_id].completed
-        return create_figure(courses, group_colors, group_credits)
+            node_id = click_data["points"][0].get("text")
+            if node_id in model.node_index:
+                with metrics.timed("toggle"):
+                    changed = state.toggle(model.node_index[node_id])
+                if not stale:
+                    with metrics.timed("patch"):
+                        patched = patch_toggle(model, state, catalog.group_credits, changed)
+                    return "click", (patched, catalog.state_json(state), no_update)
+        return "load", (overview_figure(catalog, state), catalog.state_json(state), no_update)
+
+    @app.callback(
+        [Output("course-graph", "figure", allow_duplicate=True), Output(state_id, "data", allow_duplicate=True),
+         Output("lod-view", "data", allow_duplicate=True)],
+        [Input("focus-course", "value"), Input("focus-depth", "value"), Input("reset-button", "n_clicks")],
+        State(state_id, "data"),
+        prevent_initial_call=True
+    )
+    def update_focus(focus, depth, reset_clicks, state_data):
+        # Entering, moving or leaving the focus view renders a whole new
+        # figure; the focus view is small, so it is re-rendered on reset too
+        catalog, state = live.restore(state_data)
+        model = catalog.model
+        if focus not in model.node_index:
+            if ctx.triggered_id == "reset-button":
+                return no_update, no_update, no_update
+            return overview_figure(catalog, state), catalog.state_json(state), None
+        start = time.perf_counter()
+        if ctx.triggered_id == "reset-button":
+            state = CompletionState.from_json(model, catalog.default_state)
+        center = model.node_index[focus]
 
-    app.run_server(debug=True)
+        def render():
+            with metrics.timed("focus_nodes"):
+                nodes = focus_nodes(model, center, depth or None)
+            return create_focus_figure(model, state, nodes, center, catalog.webgl, args.validate_figures)
+        view = (focus, depth or None)
+        figure = figures.get((program.id, catalog.version, format(state.completed, "x"), view), render)
+        metrics.CALLBACK_SECONDS.observe(time.perf_counter() - start, callback="update_focus", action="focus")
+        return figure, catalog.state_json(state), no_update
+
+    @app.callback(
+        Output("focus-course", "options"),
+        [Input("focus-course", "search_value"), Input("focus-course", "value")]
+    )
+    def update_focus_options(search, focus):
+        # Only the first SEARCH_LIMIT matches go to the browser, plus the
+        # focused course so that the dropdown can show it
+        model = live.get().model
+        matches = search_courses(model, search, SEARCH_LIMIT) if search else []
+        if focus in model.node_index and model.node_index[focus] not in matches:
+            matches.insert(0, model.node_index[focus])
+        return [{"label": model.node_hovertext[i], "value": model.nodes[i]} for i in matches]
+
+    @app.callback(
+        [Output("plan", "children"), Output("plan-poll", "disabled")],
+        [Input(state_id, "data"), Input("credit-cap", "value"), Input("plan-poll", "n_intervals")],
+        State("plan", "children")
+    )
+    def update_plan(state_data, credit_cap, n_intervals, current):
+        # While the job runs, keep showing the previous plan and poll; a
+        # failed job is shown and polled until the worker retries it
+        catalog, state = live.restore(state_data)
+        result = analytics.result(program.id, format(state.completed, "x"), credit_cap or DEFAULT_CREDIT_CAP)
+        if result is None:
+            return (no_update if current else "Computing plan..."), False
+        return plan_summary(result), "error" not in result
+
+    if args.webgl != "off":
+        # Text drawn by Scattergl is the expensive part, so labels are only
+        # switched on when the zoomed region holds few enough nodes
+        @app.callback(
+            Output("course-graph", "figure", allow_duplicate=True),
+            Input("course-graph", "relayoutData"),
+            State("focus-course", "value"),
+            prevent_initial_call=True
+        )
+        def update_labels(relayout_data, focus):
+            # The focus view always has its labels on
+            catalog = live.get()
+            if not catalog.webgl or catalog.lod or focus:
+                return no_update
+            visible = visible_node_count(catalog.model, relayout_data)
+            patched = Patch()
+            if visible is not None and visible <= args.label_limit:
+                patched["data"][2]["mode"] = "markers+text"
+            else:
+                patched["data"][2]["mode"] = "markers"
+            return patched
+
+    if args.lod != "off":
+        # A level-of-detail catalog is drawn for the region in view: one
+        # summary node per group when zoomed out, the courses themselves once
+        # few enough are in view. The region is kept in the lod-view store,
+        # since a figure rendered here does not report its ranges back
+        @app.callback(
+            [Output("course-graph", "figure", allow_duplicate=True), Output(state_id, "data", allow_duplicate=True),
+             Output("focus-course", "value", allow_duplicate=True), Output("lod-view", "data", allow_duplicate=True)],
+            [Input("course-graph", "relayoutData"), Input("course-graph", "clickData"),
+             Input("reset-button", "n_clicks")],
+            [State(state_id, "data"), State("focus-course", "value"), State("lod-view", "data")],
+            prevent_initial_call=True
+        )
+        def update_viewport(relayout_data, click_data, reset_clicks, state_data, focus, view):
+            unchanged = (no_update, no_update, no_update, no_update)
+            catalog, state = live.restore(state_data)
+            model = catalog.model
+            if not catalog.lod:
+                return unchanged
+            triggered = ctx.triggered_prop_ids
+            point = click_data["points"][0] if click_data else {}
+            if focus:
+                # The focus view is complete; with --server-toggle
+                # update_graph moves the focus on a click
+                clicked = "course-graph.clickData" in triggered and point.get("text") in model.node_index
+                if clicked and not args.server_toggle:
+                    return no_update, no_update, point["text"], no_update
+                return unchanged
+
+            start = time.perf_counter()
+            if "reset-button.n_clicks" in triggered:
+                action = "reset"
+                metrics.RESETS.inc(program=program.id)
+                state = CompletionState.from_json(model, catalog.default_state)
+            elif "course-graph.clickData" in triggered:
+                if point.get("text") in model.node_index:
+                    action = "click"
+                    metrics.CLICKS.inc(program=program.id)
+                    state.toggle(model.node_index[point["text"]])
+                elif point.get("customdata") in model.label_index:
+                    # A group's summary node zooms into the group
+                    action = "zoom"
+                    view = group_extent(model, point["customdata"])
+                else:
+                    return unchanged
+            else:
+                action = "zoom"
+                new_view = viewport(relayout_data, view, model.spatial_index.bounds)
+                if new_view == view:
+                    return unchanged
+                view = new_view
+
+            if view is None:
+                figure = overview_figure(catalog, state)
+            else:
+                figure = lod_figure(catalog, state, view)
+            metrics.CALLBACK_SECONDS.observe(time.perf_counter() - start, callback="update_viewport", action=action)
+            return figure, catalog.state_json(state), no_update, view
+
+    return app
+
+
+def main():
+    args = parse_args()
+    app = create_app(args)
+    app.run(debug=True)
 
 
 if __name__ == "__main__":
@@ -0,0 +1,203 @@
+"""Latency and payload metrics of the interactive path.
+
+Stages of a callback are timed with
+
+    with metrics.timed("create_figure"):
+        ...
+
+into the course_chart_stage_seconds histogram, which install() serves in
+the Prometheus text format at /metrics with the other counters, gauges and
+histograms below. With enable_tracing() every timed stage is also an
+OpenTelemetry span.
+"""
+from contextlib import contextmanager
+import threading
+import time
+
+LATENCY_BUCKETS = (0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10)
+SIZE_BUCKETS = (256, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304, 16777216)
+
+
+def _format_labels(labelnames, values, extra=()):
+    pairs = list(zip(labelnames, values)) + list(extra)
+    if not pairs:
+        return ""
+    escaped = (str(value).replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n") for _, value in pairs)
+    return "{" + ",".join(f'{name}="{value}"' for (name, _), value in zip(pairs, escaped)) + "}"
+
+
+class Counter:
+    def __init__(self, name, help_text, labelnames=()):
+        self.name = name
+        self.help = help_text
+        self.labelnames = tuple(labelnames)
+        self._values = {}
+        self._lock = threading.Lock()
+
+    def inc(self, amount=1, **labels):
+        key = tuple(labels[name] for name in self.labelnames)
+        with self._lock:
+            self._values[key] = self._values.get(key, 0) + amount
+
+    def render(self):
+        lines = [f"# HELP {self.name} {self.help}", f"# TYPE {self.name} counter"]
+        with self._lock:
+            for key, value in sorted(self._values.items()):
+                lines.append(f"{self.name}{_format_labels(self.labelnames, key)} {value}")
+        return lines
+
+
+class Gauge:
+    def __init__(self, name, help_text, labelnames=()):
+        self.name = name
+        self.help = help_text
+        self.labelnames = tuple(labelnames)
+        self._values = {}
+        self._lock = threading.Lock()
+
+    def set(self, value, **labels):
+        key = tuple(labels[name] for name in self.labelnames)
+        with self._lock:
+            self._values[key] = value
+
+    def render(self):
+        lines = [f"# HELP {self.name} {self.help}", f"# TYPE {self.name} gauge"]
+        with self._lock:
+            for key, value in sorted(self._values.items()):
+                lines.append(f"{self.name}{_format_labels(self.labelnames, key)} {value}")
+        return lines
+
+
+class Histogram:
+    def __init__(self, name, help_text, labelnames=(), buckets=LATENCY_BUCKETS):
+        self.name = name
+        self.help = help_text
+        self.labelnames = tuple(labelnames)
+        self.buckets = tuple(buckets)
+        self._values = {}
+        self._lock = threading.Lock()
+
+    def observe(self, value, **labels):
+        key = tuple(labels[name] for name in self.labelnames)
+        with self._lock:
+            counts, total = self._values.get(key, ([0] * (len(self.buckets) + 1), 0))
+            for i, bound in enumerate(self.buckets):
+                if value <= bound:
+                    counts[i] += 1
+                    break
+            else:
+                counts[-1] += 1
+            self._values[key] = (counts, total + value)
+
+    def render(self):
+        lines = [f"# HELP {self.name} {self.help}", f"# TYPE {self.name} histogram"]
+        with self._lock:
+            for key, (counts, total) in sorted(self._values.items()):
+                cumulative = 0
+                for bound, count in zip(self.buckets + ("+Inf",), counts):
+                    cumulative += count
+                    labels = _format_labels(self.labelnames, key, [("le", bound)])
+                    lines.append(f"{self.name}_bucket{labels} {cumulative}")
+                labels = _format_labels(self.labelnames, key)
+                lines.append(f"{self.name}_sum{labels} {total}")
+                lines.append(f"{self.name}_count{labels} {cumulative}")
+        return lines
+
+
+STAGE_SECONDS = Histogram(
+    "course_chart_stage_seconds", "Time spent in one stage of loading or rendering.", ["stage"]
+)
+CALLBACK_SECONDS = Histogram(
+    "course_chart_callback_seconds", "Time spent in a Dash callback, by what triggered it.", ["callback", "action"]
+)
+RESPONSE_SECONDS = Histogram(
+    "course_chart_response_seconds", "Duration of Dash callback requests, including serialization.", ["app"]
+)
+RESPONSE_BYTES = Histogram(
+    "course_chart_response_bytes", "Size of Dash callback responses before compression.", ["app"], SIZE_BUCKETS
+)
+CLICKS = Counter(
+    "course_chart_clicks_total", "Course clicks handled by the server (browser-side toggles are not seen).",
+    ["program"]
+)
+RESETS = Counter("course_chart_resets_total", "Resets handled by the server.", ["program"])
+PAYLOAD_BYTES = Counter("course_chart_payload_bytes_total", "Bytes of Dash callback responses.", ["app"])
+FIGURE_CACHE = Counter("course_chart_figure_cache_total", "Figure cache lookups, by hit or miss.", ["result"])
+FIGURE_CACHE_BYTES = Gauge(
+    "course_chart_figure_cache_bytes", "Size of the figure JSON in the cache, and the most it keeps.", ["kind"]
+)
+METRICS = [
+    STAGE_SECONDS, CALLBACK_SECONDS, RESPONSE_SECONDS, RESPONSE_BYTES, CLICKS, RESETS, PAYLOAD_BYTES, FIGURE_CACHE,
+    FIGURE_CACHE_BYTES
+]
+
+_tracer = None
+
+
+def enable_tracing():
+    """Emit an OpenTelemetry span per timed stage; returns False without opentelemetry-api."""
+    global _tracer
+    try:
+        from opentelemetry import trace
+    except ImportError:
+        return False
+    _tracer = trace.get_tracer("course_chart")
+    return True
+
+
+class Timer:
+    """A stage being timed; stop() records it. See timed() for blocks."""
+
+    def __init__(self, stage):
+        self.stage = stage
+        self.span = _tracer.start_as_current_span(stage) if _tracer is not None else None
+        if self.span is not None:
+            self.span.__enter__()
+        self.start = time.perf_counter()
+
+    def stop(self):
+        STAGE_SECONDS.observe(time.perf_counter() - self.start, stage=self.stage)
+        if self.span is not None:
+            self.span.__exit__(None, None, None)
+
+
+@contextmanager
+def timed(stage):
+    """Time the block into STAGE_SECONDS, inside a span when tracing is on."""
+    timer = Timer(stage)
+    try:
+        yield
+    finally:
+        timer.stop()
+
+
+def render():
+    """All metrics in the Prometheus text exposition format."""
+    lines = []
+    for metric in METRICS:
+        lines.extend(metric.render())
+    return "\n".join(lines) + "\n"
+
+
+def install(server):
+    """Serve /metrics on a Flask server and measure its Dash callback responses."""
+    import flask
+
+    @server.route("/metrics")
+    def prometheus_metrics():
+        return flask.Response(render(), mimetype="text/plain; version=0.0.4")
+
+    @server.before_request
+    def start_timer():
+        flask.g.course_chart_start = time.perf_counter()
+
+    @server.after_request
+    def record_response(response):
+        path = flask.request.path
+        if path.endswith("/_dash-update-component") and not response.direct_passthrough:
+            app = path[:-len("/_dash-update-component")] or "/"
+            size = len(response.get_data())
+            RESPONSE_SECONDS.observe(time.perf_counter() - flask.g.course_chart_start, app=app)
+            RESPONSE_BYTES.observe(size, app=app)
+            PAYLOAD_BYTES.inc(size, app=app)
+        return response
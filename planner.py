@@ -0,0 +1,97 @@
+"""Semester planner over the prerequisite DAG.
+
+Given a completion state, the planner takes the remaining courses chosen by
+RequirementSolver to reach every group's Credits Needed:, together with their
+unmet prerequisites, and list-schedules them into terms under a credit cap. Courses on the longest chain of unmet
+prerequisites (the critical path) are scheduled first, since that chain
+bounds the number of terms.
+"""
+import heapq
+
+from eligibility import mask_from_indices
+from reachability import descendant_counts
+from requirements import RequirementSolver
+
+
+class Plan:
+    """Result of Planner.plan; terms and critical_path hold course numbers."""
+
+    def __init__(self, terms, critical_path, shortfall):
+        self.terms = terms
+        self.critical_path = critical_path
+        self.shortfall = shortfall
+
+    def __repr__(self):
+        return f"Plan({len(self.terms)} terms, critical path {self.critical_path}, shortfall {self.shortfall})"
+
+
+class Planner:
+    """Builds graduation plans for one GraphModel; construct once per catalog."""
+
+    def __init__(self, model, group_credits):
+        self.model = model
+        self.solver = RequirementSolver(model, group_credits)
+
+    def plan(self, state, credit_cap=16):
+        """Schedule the remaining courses into terms of at most credit_cap credits."""
+        model = self.model
+        selection = self.solver.solve(state)
+        selected, choice = selection.selected, selection.choice
+
+        # Prerequisite links inside the selection, and the height of each
+        # course: the number of terms its chain of dependents still needs
+        dependents = {i: [] for i in selected}
+        waiting = {i: 0 for i in selected}
+        for i in selected:
+            for prereq in choice[i]:
+                dependents[prereq].append(i)
+                waiting[i] += 1
+        height = {}
+        for i in reversed(self.solver.order):
+            if i in selected:
+                height[i] = 1 + max((height[d] for d in dependents[i]), default=0)
+
+        # Ties on height go to the course that more of the selection
+        # transitively depends on
+        pending = mask_from_indices(selected, len(model.nodes))
+        unlocks = descendant_counts(model, pending, selected)
+
+        # List scheduling: each term takes the ready courses with the longest
+        # remaining chain first, skipping those that no longer fit; a course
+        # is ready once its picked prerequisites are in earlier terms. Ready
+        # courses wait in one heap per credit value, so filling a term looks
+        # at the top of each heap instead of sorting every ready course again
+        ready = {}
+
+        def push(i):
+            credits = model.node_credits[i]
+            heapq.heappush(ready.setdefault(credits, []), (-height[i], -unlocks[i], -credits, i))
+
+        for i in selected:
+            if waiting[i] == 0:
+                push(i)
+        terms = []
+        while any(ready.values()):
+            term = []
+            credits = 0
+            while True:
+                fits = [heap for value, heap in ready.items() if heap and (not term or credits + value <= credit_cap)]
+                if not fits:
+                    break
+                i = heapq.heappop(min(fits))[-1]
+                term.append(i)
+                credits += model.node_credits[i]
+            for i in term:
+                for d in dependents[i]:
+                    waiting[d] -= 1
+                    if waiting[d] == 0:
+                        push(d)
+            terms.append([model.nodes[i] for i in term])
+
+        critical_path = []
+        current = max(selected, key=lambda i: (height[i], -i), default=None)
+        while current is not None:
+            critical_path.append(model.nodes[current])
+            current = max(dependents[current], key=lambda i: (height[i], -i), default=None)
+
+        return Plan(terms, critical_path, selection.shortfall)
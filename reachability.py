@@ -0,0 +1,105 @@
+"""Transitive closure of the prerequisite graph as bitsets.
+
+For every course the index keeps one integer whose bit j is set when course
+j is a transitive prerequisite (ancestors) or dependent (descendants) of
+it. Memory is quadratic (25 MB at 10k courses), so GraphModel only builds
+it up to LIMIT courses; above that, descendant_counts works CHUNK target
+courses at a time.
+"""
+
+LIMIT = 10000
+CHUNK = 4096
+
+
+def _closure(before, after):
+    """Union over the nodes reachable through before, for every node.
+
+    before[i] lists the neighbors whose masks node i includes and after is
+    the reverse adjacency. Nodes are visited in Kahn order so that every
+    neighbor is done first; the graph is acyclic (validation.check_catalog
+    refuses cycles), so every node is visited.
+    """
+    size = len(before)
+    waiting = [len(neighbors) for neighbors in before]
+    order = [i for i in range(size) if waiting[i] == 0]
+    for i in order:
+        for j in after[i]:
+            waiting[j] -= 1
+            if waiting[j] == 0:
+                order.append(j)
+
+    masks = [0] * size
+    for i in order:
+        mask = 0
+        for neighbor in before[i]:
+            mask |= masks[neighbor] | 1 << neighbor
+        masks[i] = mask
+    return masks
+
+
+def _counts(model, targets):
+    """Number of transitive dependents among targets (a list of nodes) of every node."""
+    rank = {j: k for k, j in enumerate(targets)}
+    size = len(model.nodes)
+    waiting = [len(neighbors) for neighbors in model.successors]
+    order = [i for i in range(size) if waiting[i] == 0]
+    for i in order:
+        for j in model.predecessors[i]:
+            waiting[j] -= 1
+            if waiting[j] == 0:
+                order.append(j)
+
+    masks = [0] * size
+    for i in order:
+        mask = 0
+        for dependent in model.successors[i]:
+            mask |= masks[dependent]
+            if dependent in rank:
+                mask |= 1 << rank[dependent]
+        masks[i] = mask
+    return [bin(mask).count("1") for mask in masks]
+
+
+def descendant_counts(model, within, nodes):
+    """Number of transitive dependents of each of nodes inside the bitmask within, as a dict.
+
+    Uses the model's index when it has one; otherwise the closure is
+    computed over at most CHUNK target bits at a time, so memory stays at
+    n * CHUNK / 8 bytes whatever the catalog size.
+    """
+    reach = model.reachability
+    if reach is not None:
+        return {i: reach.count(reach.descendants[i] & within) for i in nodes}
+    targets = [j for j in range(len(model.nodes)) if within >> j & 1]
+    counts = {i: 0 for i in nodes}
+    for start in range(0, len(targets), CHUNK):
+        chunk = _counts(model, targets[start:start + CHUNK])
+        for i in counts:
+            counts[i] += chunk[i]
+    return counts
+
+
+class ReachabilityIndex:
+    """Ancestor and descendant bitsets of every course of a GraphModel."""
+
+    def __init__(self, model):
+        self.size = len(model.nodes)
+        self.ancestors = _closure(model.predecessors, model.successors)
+        self.descendants = _closure(model.successors, model.predecessors)
+
+    def requires(self, course, prerequisite):
+        """Whether prerequisite is a transitive prerequisite of course."""
+        return bool(self.ancestors[course] >> prerequisite & 1)
+
+    def unlocks(self, course, dependent):
+        """Whether dependent transitively depends on course."""
+        return bool(self.descendants[course] >> dependent & 1)
+
+    def neighborhood(self, course):
+        """Bitmask of a course with all of its ancestors and descendants."""
+        return self.ancestors[course] | self.descendants[course] | 1 << course
+
+    @staticmethod
+    def count(mask):
+        """Number of courses in a bitmask."""
+        return bin(mask).count("1")
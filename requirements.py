@@ -0,0 +1,196 @@
+"""Minimum-credit selection of the remaining courses for group requirements.
+
+Each group in groups.csv needs a number of credits. Choosing which of its
+courses to take is a knapsack: every course brings its own credits towards
+the group and costs its credits plus those of its unmet prerequisites (the
+cheapest course of each OR-group). A DP over the remaining credits finds the
+cheapest choice per group, merging in the courses one credit value at a
+time. Selections are cached per completion bitmask in a bounded LRU, so
+going back to an earlier state skips the work entirely.
+"""
+from collections import OrderedDict
+
+from eligibility import mask_to_flags
+from layout import longest_path_ranks
+
+_INFINITY = 10 ** 18
+
+
+def _take_cheapest(best, gain, prices):
+    """Merge k courses of gain credits each, at a total of prices[k], into best.
+
+    Returns (merged, taken), taken[r] being the number of those courses
+    behind merged[r]. Along every residue chain r = c + t * gain this is a
+    min-plus convolution with the convex prices (they add up sorted costs),
+    so the best k is monotone in t and a divide and conquer finds it with
+    O(log) candidates per entry instead of one per course.
+    """
+    needed = len(best) - 1
+    count = len(prices) - 1
+    merged = best[:]
+    taken = [0] * (needed + 1)
+
+    # Past the last course the price keeps growing convexly
+    prices = prices + [prices[count] + _INFINITY * k for k in range(1, needed // gain + 2)]
+
+    for c in range(min(gain, needed + 1)):
+        # chain[s] is the entry s steps below, chain[0] standing for an
+        # overshoot below zero (worth best[0]) when c is not zero itself
+        positions = list(range(c, needed + 1, gain))
+        chain = [best[r] for r in positions]
+        if c:
+            positions.insert(0, None)
+            chain.insert(0, best[0])
+        stack = [(0, len(chain) - 1, 0, len(chain) - 1)]
+        while stack:
+            low, high, first, last = stack.pop()
+            if low > high:
+                continue
+            t = (low + high) // 2
+            value, arg = float("inf"), first
+            for s in range(first, min(t, last) + 1):
+                if chain[s] + prices[t - s] < value:
+                    value, arg = chain[s] + prices[t - s], s
+            if positions[t] is not None and value < merged[positions[t]]:
+                merged[positions[t]] = value
+                taken[positions[t]] = t - arg
+            stack.append((low, t - 1, first, arg))
+            stack.append((t + 1, high, arg, last))
+    return merged, taken
+
+
+class Selection:
+    """Courses picked by RequirementSolver.solve, as node indices.
+
+    choice[i] lists the course picked for each unmet prerequisite group of
+    course i; shortfall maps a group to credits it cannot reach.
+    """
+
+    def __init__(self, done, selected, choice, shortfall):
+        self.done = done
+        self.selected = selected
+        self.choice = choice
+        self.shortfall = shortfall
+
+
+class RequirementSolver:
+    """Solves group requirements for one GraphModel; construct once per catalog."""
+
+    def __init__(self, model, group_credits, maxsize=1024):
+        self.model = model
+        self.group_credits = group_credits
+        ranks = longest_path_ranks(model)
+        self.order = sorted(range(len(model.nodes)), key=ranks.__getitem__)  # prerequisites first
+        self.group_members = {group: [] for group in model.groups}
+        for i, group in enumerate(model.node_group):
+            self.group_members[group].append(i)
+        self.maxsize = maxsize
+        self._cache = OrderedDict()
+        self.hits = 0
+        self.misses = 0
+
+    def prerequisite_costs(self, done):
+        """Credits needed to take each course, including unmet prerequisites.
+
+        Returns (cost, choice): choice[i] lists the course picked for each of
+        course i's unmet prerequisite groups, the one with the lowest cost.
+        Shared prerequisites are counted once per path, so cost is an upper
+        bound.
+        """
+        model = self.model
+        alternatives = model.engine.alternatives
+        cost = [0] * len(model.nodes)
+        choice = [()] * len(model.nodes)
+        for i in self.order:
+            if done[i] == "1":
+                continue
+            total = model.node_credits[i]
+            picks = []
+            for members in alternatives[i]:
+                if any(done[m] == "1" for m in members):
+                    continue
+                best = min(members, key=cost.__getitem__)
+                total += cost[best]
+                picks.append(best)
+            cost[i] = total
+            choice[i] = picks
+        return cost, choice
+
+    @staticmethod
+    def cheapest_subset(candidates, credits, cost, needed):
+        """0/1 knapsack: the candidates reaching needed credits at the lowest cost.
+
+        Among courses of the same credits the cheapest are always taken
+        first, so the choice is how many of each credit value to take; a DP
+        over the credit values keeps best[r], the lowest cost of reaching at
+        least r credits, and merges in each value with _take_cheapest.
+        Returns None if the candidates cannot reach needed credits.
+        """
+        by_credits = {}
+        for i in candidates:
+            if credits[i] > 0:
+                by_credits.setdefault(min(credits[i], needed), []).append(i)
+        best = [0] + [_INFINITY] * needed
+        counts = []
+        for gain, members in by_credits.items():
+            members.sort(key=cost.__getitem__)
+            prices = [0]
+            for i in members:
+                prices.append(prices[-1] + cost[i])
+            best, taken = _take_cheapest(best, gain, prices)
+            counts.append((gain, members, taken))
+
+        if best[needed] >= _INFINITY:
+            return None
+        subset = []
+        r = needed
+        for gain, members, taken in reversed(counts):
+            subset.extend(members[:taken[r]])
+            r = max(0, r - taken[r] * gain)
+        return subset
+
+    def solve(self, state):
+        """Selection of courses reaching every group's required credits."""
+        key = state.completed
+        if key in self._cache:
+            self._cache.move_to_end(key)
+            self.hits += 1
+            return self._cache[key]
+        self.misses += 1
+
+        model = self.model
+        done = mask_to_flags(state.completed, len(model.nodes))
+        cost, choice = self.prerequisite_costs(done)
+        selected = set()
+        planned = {group: 0 for group in model.groups}
+
+        def take(course):
+            stack = [course]
+            while stack:
+                i = stack.pop()
+                if done[i] == "1" or i in selected:
+                    continue
+                selected.add(i)
+                planned[model.node_group[i]] += model.node_credits[i]
+                stack.extend(choice[i])
+
+        # Groups are solved one after another; courses pulled in as
+        # prerequisites by earlier groups already count towards theirs
+        shortfall = {}
+        for group, needed in self.group_credits.items():
+            remaining = needed - state.group_completed_credits.get(group, 0) - planned.get(group, 0)
+            if remaining <= 0:
+                continue
+            candidates = [i for i in self.group_members.get(group, []) if done[i] != "1" and i not in selected]
+            subset = self.cheapest_subset(candidates, model.node_credits, cost, remaining)
+            if subset is None:
+                subset = candidates
+                shortfall[group] = remaining - sum(model.node_credits[i] for i in candidates)
+            for i in subset:
+                take(i)
+
+        selection = Selection(done, selected, choice, shortfall)
+        self._cache[key] = selection
+        if len(self._cache) > self.maxsize:
+            self._cache.popitem(last=False)
+        return selection
@@ -0,0 +1,248 @@
+"""Binary, memory-mappable snapshot of a parsed catalog.
+
+The snapshot stores the three catalog files as flat uint32/int32 arrays that
+index into a shared string table, prefixed by a SHA-256 of the source files.
+Loading it is a handful of array casts over an mmap instead of CSV parsing
+and prerequisite-expression splitting; a changed source file changes the
+hash, which makes the snapshot stale.
+
+Layout (all integers native-endian, every section 4-byte aligned):
+
+    header          MAGIC, source hash, validated flag, section counts (HEADER)
+    string_offsets  uint32[n_strings + 1]
+    string_data     utf-8 bytes, padded to 4
+    course_number   uint32[n_courses]   string ids
+    course_name     uint32[n_courses]   string ids
+    course_group    uint32[n_courses]   string ids
+    course_credits  int32[n_courses]
+    course_done     uint32[n_courses]   0/1
+    prereq_group_ptr  uint32[n_courses + 1]   CSR over prerequisite groups
+    prereq_item_ptr   uint32[n_prereq_groups + 1]
+    prereq_items      uint32[n_prereq_items]  string ids
+    color_group     uint32[n_colors]    string ids, in group_colors order
+    color_value     uint32[n_colors]    string ids
+    group_name      uint32[n_groups]    string ids, in groups.csv order
+    group_needed    int32[n_groups]
+    duplicate       uint32[n_duplicates]      string ids, of the CatalogReport
+    dangling_course uint32[n_dangling]        string ids
+    dangling_prereq uint32[n_dangling]        string ids
+    missing_group   uint32[n_missing_groups]  string ids
+
+A snapshot holds the catalog as check_catalog left it (dangling
+prerequisites dropped) together with the report, when validated is set in
+the header, so loading it neither has to check the catalog again nor
+forgets the problems --strict-catalog refuses.
+"""
+import hashlib
+import mmap
+import os
+import struct
+import sys
+from array import array
+
+from validation import CatalogReport
+
+MAGIC = b"CDCSNAP2"
+FORMAT_VERSION = 2
+HEADER = struct.Struct("<8s32s11I")
+
+
+def source_hash(*file_paths):
+    """SHA-256 over the format version, byte order and source file contents."""
+    digest = hashlib.sha256(f"{FORMAT_VERSION}:{sys.byteorder}".encode())
+    for file_path in file_paths:
+        with open(file_path, "rb") as f:
+            for chunk in iter(lambda: f.read(1 << 20), b""):
+                digest.update(chunk)
+        digest.update(b"\0")
+    return digest.digest()
+
+
+class _StringTable:
+    def __init__(self):
+        self.ids = {}
+        self.strings = []
+
+    def intern(self, value):
+        string_id = self.ids.get(value)
+        if string_id is None:
+            string_id = self.ids[value] = len(self.strings)
+            self.strings.append(value)
+        return string_id
+
+
+def _padded(data):
+    return data + b"\0" * (-len(data) % 4)
+
+
+def write_snapshot(path, digest, courses, group_colors, group_credits, report=None):
+    """Write courses, group_colors and group_credits to a snapshot file.
+
+    report is the CatalogReport check_catalog returned for them; without it
+    the snapshot is marked as not validated. The file is written next to its
+    destination and renamed into place, so concurrent readers never see a
+    partial snapshot.
+    """
+    table = _StringTable()
+    course_number = array("I")
+    course_name = array("I")
+    course_group = array("I")
+    course_credits = array("i")
+    course_done = array("I")
+    prereq_group_ptr = array("I", [0])
+    prereq_item_ptr = array("I", [0])
+    prereq_items = array("I")
+
+    for course in courses.values():
+        course_number.append(table.intern(course.class_number))
+        course_name.append(table.intern(course.name))
+        course_group.append(table.intern(course.group))
+        course_credits.append(course.credits)
+        course_done.append(int(course.completed))
+        for prereq_group in course.prerequisites:
+            prereq_items.extend(table.intern(prereq) for prereq in prereq_group)
+            prereq_item_ptr.append(len(prereq_items))
+        prereq_group_ptr.append(len(prereq_item_ptr) - 1)
+
+    color_group = array("I", [table.intern(group) for group in group_colors])
+    color_value = array("I", [table.intern(color) for color in group_colors.values()])
+    group_name = array("I", [table.intern(group) for group in group_credits])
+    group_needed = array("i", list(group_credits.values()))
+    duplicates = array("I", [table.intern(number) for number in report.duplicates] if report else [])
+    dangling_course = array("I", [table.intern(number) for number, _ in report.dangling] if report else [])
+    dangling_prereq = array("I", [table.intern(prereq) for _, prereq in report.dangling] if report else [])
+    missing_group = array("I", [table.intern(group) for group in report.missing_groups] if report else [])
+
+    encoded = [string.encode("utf-8") for string in table.strings]
+    string_offsets = array("I", [0])
+    for data in encoded:
+        string_offsets.append(string_offsets[-1] + len(data))
+    string_data = b"".join(encoded)
+
+    header = HEADER.pack(
+        MAGIC, digest, int(report is not None), len(encoded), len(string_data), len(courses),
+        len(prereq_item_ptr) - 1, len(prereq_items), len(color_group), len(group_name),
+        len(duplicates), len(dangling_course), len(missing_group)
+    )
+    sections = [
+        string_offsets, _padded(string_data), course_number, course_name, course_group,
+        course_credits, course_done, prereq_group_ptr, prereq_item_ptr, prereq_items,
+        color_group, color_value, group_name, group_needed,
+        duplicates, dangling_course, dangling_prereq, missing_group,
+    ]
+
+    tmp_path = f"{path}.{os.getpid()}.tmp"
+    with open(tmp_path, "wb") as f:
+        f.write(header)
+        for section in sections:
+            f.write(section if isinstance(section, bytes) else section.tobytes())
+    os.replace(tmp_path, path)
+
+
+def read_snapshot(path, digest=None):
+    """Read a snapshot written by write_snapshot.
+
+    Returns None if the file is missing, is not a snapshot or, when digest is
+    given, was built from different sources. Otherwise returns a tuple of
+    (courses, group_colors, group_credits, report) where courses is a list of
+    (class_number, name, group, credits, completed, prerequisites) tuples in
+    catalog order and report the stored CatalogReport, or None if the
+    snapshot was not validated.
+    """
+    try:
+        f = open(path, "rb")
+    except FileNotFoundError:
+        return None
+    with f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mapped:
+        view = memoryview(mapped)
+        try:
+            if len(view) < HEADER.size:
+                return None
+            magic, stored_digest, *counts = HEADER.unpack_from(view)
+            if magic != MAGIC or (digest is not None and stored_digest != digest):
+                return None
+            return _decode(view, counts)
+        finally:
+            view.release()
+
+
+def snapshot_digest(path):
+    """The source hash in a snapshot's header, or None if the file is missing or not a snapshot."""
+    try:
+        with open(path, "rb") as f:
+            header = f.read(HEADER.size)
+    except FileNotFoundError:
+        return None
+    if len(header) < HEADER.size:
+        return None
+    magic, digest, *_ = HEADER.unpack(header)
+    return digest if magic == MAGIC else None
+
+
+def _decode(view, counts):
+    (validated, n_strings, string_bytes, n_courses, n_prereq_groups, n_prereq_items, n_colors, n_groups,
+     n_duplicates, n_dangling, n_missing_groups) = counts
+    offset = HEADER.size
+
+    def take(count, typecode="I"):
+        nonlocal offset
+        size = 4 * count
+        section = view[offset:offset + size].cast(typecode)
+        offset += size
+        return section
+
+    string_offsets = take(n_strings + 1)
+    string_data = bytes(view[offset:offset + string_bytes])
+    offset += string_bytes + (-string_bytes % 4)
+    bounds = string_offsets.tolist()
+    if string_data.isascii():
+        # Byte offsets are character offsets, so the table is decoded once and sliced
+        text = string_data.decode("ascii")
+        strings = [text[start:stop] for start, stop in zip(bounds, bounds[1:])]
+    else:
+        strings = [string_data[start:stop].decode("utf-8") for start, stop in zip(bounds, bounds[1:])]
+
+    # Every section as one list, then the rows are assembled by slicing
+    lookup = strings.__getitem__
+    course_number = take(n_courses)
+    course_name = take(n_courses)
+    course_group = take(n_courses)
+    course_credits = take(n_courses, "i")
+    course_done = take(n_courses)
+    prereq_group_ptr = take(n_courses + 1)
+    prereq_item_ptr = take(n_prereq_groups + 1)
+    prereq_items = take(n_prereq_items)
+    color_group = take(n_colors)
+    color_value = take(n_colors)
+    group_name = take(n_groups)
+    group_needed = take(n_groups, "i")
+    duplicates = take(n_duplicates)
+    dangling_course = take(n_dangling)
+    dangling_prereq = take(n_dangling)
+    missing_group = take(n_missing_groups)
+
+    items = list(map(lookup, prereq_items.tolist()))
+    item_ptr = prereq_item_ptr.tolist()
+    prereq_groups = [items[start:stop] for start, stop in zip(item_ptr, item_ptr[1:])]
+    group_ptr = prereq_group_ptr.tolist()
+    courses = list(zip(
+        map(lookup, course_number.tolist()), map(lookup, course_name.tolist()), map(lookup, course_group.tolist()),
+        course_credits.tolist(), map(bool, course_done.tolist()),
+        [prereq_groups[start:stop] for start, stop in zip(group_ptr, group_ptr[1:])],
+    ))
+    group_colors = {strings[color_group[i]]: strings[color_value[i]] for i in range(n_colors)}
+    group_credits = {strings[group_name[i]]: group_needed[i] for i in range(n_groups)}
+    report = None
+    if validated:
+        report = CatalogReport(
+            [strings[i] for i in duplicates],
+            [(strings[course], strings[prereq]) for course, prereq in zip(dangling_course, dangling_prereq)],
+            [strings[i] for i in missing_group],
+            [],
+        )
+
+    for section in (string_offsets, course_number, course_name, course_group, course_credits, course_done,
+                    prereq_group_ptr, prereq_item_ptr, prereq_items, color_group, color_value,
+                    group_name, group_needed, duplicates, dangling_course, dangling_prereq, missing_group):
+        section.release()
+    return courses, group_colors, group_credits, report
@@ -0,0 +1,385 @@
+"""Catalogs read from a registrar database or REST API instead of files.
+
+A manifest entry (see catalogs.py) names a source instead of the three files:
+
+    {"id": "ce", "title": "Computer Engineering",
+     "source": {"type": "database", "dsn": "postgresql://registrar/catalog", "pool_size": 4}}
+    {"id": "ee", "source": {"type": "rest", "url": "https://registrar.example.edu/api/catalog/ee"}}
+
+Both serve the rows of the three files as three tables, keyed by their first
+column:
+
+    courses        number, name, group_name, credits, completed
+    groups         group_name, credits_needed
+    prerequisites  number, prerequisites ("A OR B, C" as in prereqs.tsv)
+
+Every row also has a deleted flag, so a row removed since a cursor can be
+reported as a tombstone; a hard delete is only noticed by a full sync.
+
+The database source (PostgreSQL, needs asyncpg) reads tables or views with
+these columns plus updated_at. The REST source (needs aiohttp) calls
+GET <url>/<table>?page=&per_page=[&since=<cursor>], answered with
+{"items": [...], "pages": <count>, "cursor": <opaque string>}; pages after
+the first are asked with until=<cursor of the first page>, so they describe
+the same state.
+
+A SourceSync keeps the rows of one source in memory and in a state file next
+to the program's caches, with a cursor per table. pull() fetches only the
+rows changed since the cursors: the three tables at once, each split into
+pages fetched concurrently over a bounded pool of connections (from one
+database snapshot, see DatabaseSource), in one event loop kept for the life
+of the process so connections are reused between syncs. Nothing is applied
+unless every table was read.
+"""
+import asyncio
+from datetime import datetime, timedelta
+import hashlib
+import json
+import os
+
+# Key column and (column, type) of the other columns of every table
+TABLES = {
+    "courses": ("number", [("name", str), ("group_name", str), ("credits", int), ("completed", "flag")]),
+    "groups": ("group_name", [("credits_needed", int)]),
+    "prerequisites": ("number", [("prerequisites", str)]),
+}
+STATE_VERSION = 1
+RETRY_STATUS = {429, 500, 502, 503, 504}
+
+
+class SourceError(Exception):
+    """Raised when a catalog source cannot be read."""
+
+
+def _flag(value):
+    return value if isinstance(value, bool) else str(value).strip().lower() in ("true", "1")
+
+
+def _record(table, row):
+    """(key, values) of a fetched row, with the values normalized to their types."""
+    key, fields = TABLES[table]
+    try:
+        return str(row[key]).strip(), tuple(
+            _flag(row[name]) if kind == "flag" else kind(row[name]) for name, kind in fields
+        )
+    except (KeyError, TypeError, ValueError) as error:
+        raise SourceError(f"{table}: malformed row {dict(row)!r} ({error!r})") from None
+
+
+class DatabaseSource:
+    """The three tables in a PostgreSQL database, read through an asyncpg pool.
+
+    tables renames the tables (e.g. to views over the registrar's schema);
+    page_size is the number of rows per query. Every pull reads one
+    REPEATABLE READ snapshot: a connection opens the transaction and
+    exports its snapshot, which the connections reading the pages import,
+    so the pages and tables agree with each other however long the pull
+    takes. A table's cursor is the latest updated_at in that snapshot, and
+    the next pull asks for rows updated after the cursor minus lag_seconds:
+    a transaction that commits after a pull with an earlier updated_at is
+    still picked up if it took less than the lag (rows read twice are
+    deduplicated by key).
+    """
+
+    def __init__(self, dsn, tables=None, pool_size=4, page_size=5000, lag_seconds=60):
+        self.dsn = dsn
+        self.tables = {table: table for table in TABLES}
+        unknown = set(tables or ()) - set(TABLES)
+        if unknown:
+            raise ValueError(f"unknown table(s) {', '.join(sorted(unknown))}")
+        if pool_size < 2:
+            raise ValueError("pool_size must be at least 2: one connection holds the snapshot the others read")
+        self.tables.update(tables or {})
+        self.pool_size = pool_size
+        self.page_size = page_size
+        self.lag = timedelta(seconds=lag_seconds)
+        self.pool = None
+
+    def reset(self):
+        # A pool inherited through fork belongs to the parent's event loop
+        self.pool = None
+
+    async def close(self):
+        if self.pool is not None:
+            await self.pool.close()
+            self.pool = None
+
+    async def open(self):
+        if self.pool is None:
+            import asyncpg
+
+            try:
+                self.pool = await asyncpg.create_pool(self.dsn, min_size=1, max_size=self.pool_size)
+            except asyncpg.PostgresError as error:
+                raise SourceError(f"{self.dsn}: {error}") from None
+
+    def _condition(self, cursor):
+        if cursor is None:
+            return "NOT deleted", []
+        return "updated_at > $1", [datetime.fromisoformat(cursor) - self.lag]
+
+    async def fetch_all(self, cursors):
+        """{table: (rows, new cursor)} of the rows changed after each table's cursor (every row when None)."""
+        import asyncpg
+
+        try:
+            async with self.pool.acquire() as connection:
+                async with connection.transaction(isolation="repeatable_read", readonly=True):
+                    snapshot_id = await connection.fetchval("SELECT pg_export_snapshot()")
+                    # Keyset pages: the first key of every page_size rows
+                    # bounds the pages, which are then read concurrently
+                    pages = []
+                    for table in TABLES:
+                        key, _ = TABLES[table]
+                        where, params = self._condition(cursors[table])
+                        starts = [record[0] for record in await connection.fetch(
+                            f"SELECT {key} FROM (SELECT {key}, row_number() OVER (ORDER BY {key}) AS n"
+                            f" FROM {self.tables[table]} WHERE {where}) AS page_keys"
+                            f" WHERE (n - 1) % {int(self.page_size)} = 0 ORDER BY {key}",
+                            *params
+                        )]
+                        pages.extend((table, start, stop) for start, stop in zip(starts, starts[1:] + [None]))
+                    # The exporting transaction stays open until every page is read
+                    results = await asyncio.gather(*(
+                        self._page(snapshot_id, table, start, stop, cursors[table]) for table, start, stop in pages
+                    ))
+        except asyncpg.PostgresError as error:
+            raise SourceError(f"{self.dsn}: {error}") from None
+
+        fetched = {table: ([], cursors[table]) for table in TABLES}
+        for (table, _, _), rows in zip(pages, results):
+            fetched[table][0].extend(rows)
+        for table, (rows, cursor) in fetched.items():
+            updated = [row["updated_at"] for row in rows if row["updated_at"] is not None]
+            if cursor is not None:
+                updated.append(datetime.fromisoformat(cursor))
+            if updated:
+                fetched[table] = (rows, max(updated).isoformat())
+        return fetched
+
+    async def _page(self, snapshot_id, table, start, stop, cursor):
+        key, fields = TABLES[table]
+        columns = ", ".join([key] + [name for name, _ in fields] + ["updated_at", "deleted"])
+        where, values = self._condition(cursor)
+        conditions = [where, f"{key} >= ${len(values) + 1}"]
+        values = values + [start]
+        if stop is not None:
+            conditions.append(f"{key} < ${len(values) + 1}")
+            values.append(stop)
+        async with self.pool.acquire() as connection:
+            async with connection.transaction(isolation="repeatable_read", readonly=True):
+                await connection.execute(f"SET TRANSACTION SNAPSHOT '{snapshot_id}'")
+                return await connection.fetch(
+                    f"SELECT {columns} FROM {self.tables[table]} WHERE {' AND '.join(conditions)}", *values
+                )
+
+
+class RestSource:
+    """The three tables behind a paginated JSON API, read through one aiohttp session.
+
+    pool_size bounds the open connections, and so the pages in flight;
+    failed requests are retried with exponential backoff.
+    """
+
+    def __init__(self, url, headers=None, pool_size=8, page_size=1000, timeout=30, retries=3):
+        self.url = url.rstrip("/")
+        self.headers = headers or {}
+        self.pool_size = pool_size
+        self.page_size = page_size
+        self.timeout = timeout
+        self.retries = retries
+        self.session = None
+
+    def reset(self):
+        # A session inherited through fork belongs to the parent's event loop
+        self.session = None
+
+    async def close(self):
+        if self.session is not None:
+            await self.session.close()
+            self.session = None
+
+    async def open(self):
+        if self.session is None:
+            import aiohttp
+
+            self.session = aiohttp.ClientSession(
+                connector=aiohttp.TCPConnector(limit=self.pool_size),
+                headers=self.headers,
+                timeout=aiohttp.ClientTimeout(total=self.timeout),
+            )
+
+    async def _get(self, table, params):
+        import aiohttp
+
+        url = f"{self.url}/{table}"
+        for attempt in range(self.retries + 1):
+            try:
+                async with self.session.get(url, params=params) as response:
+                    if response.status not in RETRY_STATUS or attempt == self.retries:
+                        response.raise_for_status()
+                        return await response.json()
+            except aiohttp.ClientResponseError as error:
+                raise SourceError(f"{url}: {error.status} {error.message}") from None
+            except (aiohttp.ClientError, asyncio.TimeoutError) as error:
+                if attempt == self.retries:
+                    raise SourceError(f"{url}: {error!r}") from None
+            await asyncio.sleep(0.5 * 2 ** attempt)
+
+    async def fetch_all(self, cursors):
+        """{table: (rows, new cursor)} of the rows changed after each table's cursor (every row when None)."""
+        results = await asyncio.gather(*(self.fetch(table, cursors[table]) for table in TABLES))
+        return dict(zip(TABLES, results))
+
+    async def fetch(self, table, cursor):
+        """(rows, new cursor) of the rows changed after cursor, or of every row when cursor is None."""
+        params = {"page": 1, "per_page": self.page_size}
+        if cursor is not None:
+            params["since"] = cursor
+        first = await self._get(table, params)
+        try:
+            rows = list(first["items"])
+            pages = int(first.get("pages", 1))
+            new_cursor = str(first["cursor"])
+        except (KeyError, TypeError, ValueError):
+            raise SourceError(f"{self.url}/{table}: expected items, pages and cursor in the response") from None
+        # The remaining pages at once, as many in flight as the connector allows
+        later = await asyncio.gather(*(
+            self._get(table, dict(params, page=page, until=new_cursor)) for page in range(2, pages + 1)
+        ))
+        for response in later:
+            try:
+                rows.extend(response["items"])
+            except (KeyError, TypeError):
+                raise SourceError(f"{self.url}/{table}: expected items in the response") from None
+        return rows, new_cursor
+
+
+SOURCES = {"database": DatabaseSource, "rest": RestSource}
+
+
+def make_source(config):
+    """The source a manifest entry's "source" object describes; raises ValueError."""
+    if not isinstance(config, dict):
+        raise ValueError("source must be an object")
+    options = dict(config)
+    kind = options.pop("type", None)
+    if kind not in SOURCES:
+        raise ValueError(f"source type must be one of {', '.join(SOURCES)}, not {kind!r}")
+    try:
+        return SOURCES[kind](**options)
+    except TypeError as error:
+        raise ValueError(f"{kind} source: {error}") from None
+
+
+class SourceSync:
+    """The rows of one source, kept current by incremental pulls.
+
+    rows maps every table to {key: values}; cursors holds the cursor of each
+    table after the last pull (None before the first). With a state_path
+    both survive restarts, so a restart only fetches what changed meanwhile.
+    """
+
+    def __init__(self, source, state_path=None):
+        self.source = source
+        self.state_path = state_path
+        self.rows = {table: {} for table in TABLES}
+        self.cursors = {table: None for table in TABLES}
+        self._loop = None
+        self._loop_pid = None
+        if state_path:
+            self.read_state()
+
+    def read_state(self):
+        """Take the rows and cursors from state_path, e.g. after another process pulled."""
+        try:
+            with open(self.state_path, encoding="utf-8") as f:
+                state = json.load(f)
+        except FileNotFoundError:
+            return
+        except (OSError, ValueError) as error:
+            print(f"Ignoring source state {self.state_path}: {error}")
+            return
+        if state.get("version") != STATE_VERSION or set(state.get("rows", ())) != set(TABLES):
+            return
+        self.rows = {table: {key: tuple(values) for key, values in rows.items()} for table, rows in state["rows"].items()}
+        self.cursors = {table: state["cursors"].get(table) for table in TABLES}
+
+    def _write_state(self):
+        tmp_path = f"{self.state_path}.{os.getpid()}.tmp"
+        with open(tmp_path, "w", encoding="utf-8") as f:
+            json.dump({"version": STATE_VERSION, "cursors": self.cursors, "rows": self.rows}, f)
+        os.replace(tmp_path, self.state_path)
+
+    def _run(self, coroutine):
+        # One loop per process, kept between pulls so the source's pool is reused
+        if self._loop_pid != os.getpid():
+            self._loop_pid = os.getpid()
+            self._loop = asyncio.new_event_loop()
+            self.source.reset()
+        return self._loop.run_until_complete(coroutine)
+
+    def close(self):
+        """Close the source's pool or session, e.g. before a WSGI server forks."""
+        if self._loop is not None and self._loop_pid == os.getpid():
+            self._loop.run_until_complete(self.source.close())
+            self._loop.close()
+        self._loop = None
+        self._loop_pid = None
+
+    async def _fetch_all(self):
+        await self.source.open()
+        return await self.source.fetch_all(self.cursors)
+
+    def pull(self):
+        """Fetch and apply the rows changed since the cursors; returns the number of rows that changed."""
+        fetched = self._run(self._fetch_all())
+        changed = 0
+        moved = False
+        for table, (rows, cursor) in fetched.items():
+            stored = self.rows[table]
+            for row in rows:
+                if _flag(row.get("deleted", False)):
+                    key = str(row[TABLES[table][0]]).strip()
+                    if stored.pop(key, None) is not None:
+                        changed += 1
+                    continue
+                key, values = _record(table, row)
+                if stored.get(key) != values:
+                    stored[key] = values
+                    changed += 1
+            moved |= cursor != self.cursors[table]
+            self.cursors[table] = cursor
+        if self.state_path and (changed or moved):
+            try:
+                self._write_state()
+            except OSError as error:
+                print(f"Could not write source state {self.state_path}: {error}")
+        return changed
+
+    def digest(self):
+        """SHA-256 of the rows, which versions the catalog like snapshot.source_hash does for files."""
+        data = json.dumps(self.rows, sort_keys=True, separators=(",", ":"))
+        return hashlib.sha256(f"source:{STATE_VERSION}:{data}".encode()).digest()
+
+    def catalog(self):
+        """Fresh (courses, group_colors, group_credits), as main.load_catalog parses them from files.
+
+        Courses are in course number order, which also fixes the order of
+        the group colors; groups are in name order.
+        """
+        from main import Course, generate_colors, parse_prerequisite_expression
+
+        courses = {}
+        group_colors = {}
+        color_generator = generate_colors()
+        for number in sorted(self.rows["courses"]):
+            name, group, credits, completed = self.rows["courses"][number]
+            if group not in group_colors:
+                group_colors[group] = next(color_generator)
+            courses[number] = Course(number, name, group, credits, str(completed))
+        for number, (prerequisites,) in self.rows["prerequisites"].items():
+            if number in courses:
+                courses[number].prerequisites.extend(parse_prerequisite_expression(prerequisites))
+        group_credits = {group: needed for group, (needed,) in sorted(self.rows["groups"].items())}
+        return courses, group_colors, group_credits
@@ -0,0 +1,52 @@
+"""Uniform grid index over the node positions, for viewport queries.
+
+The layout never changes at runtime, so the grid is built once per model:
+the bounding box of the points is cut into about one cell per
+POINTS_PER_CELL points and every point is filed under its cell. A
+rectangle query then only looks at the points of the cells it overlaps,
+which for a zoomed-in view is a small fraction of the catalog.
+"""
+import math
+
+POINTS_PER_CELL = 8
+
+
+class GridIndex:
+    """Points (x, y) bucketed by grid cell; queries return point indices."""
+
+    def __init__(self, points):
+        self.points = points
+        if points:
+            xs = [x for x, _ in points]
+            ys = [y for _, y in points]
+            self.bounds = (min(xs), max(xs), min(ys), max(ys))
+        else:
+            self.bounds = (0.0, 0.0, 0.0, 0.0)
+        x0, x1, y0, y1 = self.bounds
+        self.columns = self.rows = max(1, math.isqrt(len(points) // POINTS_PER_CELL))
+        self.cell_width = (x1 - x0) / self.columns or 1.0
+        self.cell_height = (y1 - y0) / self.rows or 1.0
+        self.cells = {}
+        for i, (x, y) in enumerate(points):
+            self.cells.setdefault(self._cell(x, y), []).append(i)
+
+    def _cell(self, x, y):
+        x0, _, y0, _ = self.bounds
+        column = min(self.columns - 1, max(0, int((x - x0) / self.cell_width)))
+        row = min(self.rows - 1, max(0, int((y - y0) / self.cell_height)))
+        return column, row
+
+    def query(self, x0, x1, y0, y1):
+        """Sorted indices of the points with x0 <= x <= x1 and y0 <= y <= y1."""
+        first_column, first_row = self._cell(x0, y0)
+        last_column, last_row = self._cell(x1, y1)
+        points = self.points
+        found = []
+        for column in range(first_column, last_column + 1):
+            for row in range(first_row, last_row + 1):
+                for i in self.cells.get((column, row), ()):
+                    x, y = points[i]
+                    if x0 <= x <= x1 and y0 <= y <= y1:
+                        found.append(i)
+        found.sort()
+        return found
@@ -0,0 +1,104 @@
+"""Synthetic catalogs for benchmarks.
+
+    python synthetic.py 100000 ./bench_data
+
+writes classes.csv, groups.csv and prereqs.tsv in the format of ./mnt/data.
+Courses belong to departments and levels (100 to 500); each course takes its
+prerequisites from lower levels, mostly in its own department, so the graph
+is a DAG whose fan-in and OR-group density resemble a real catalog: level
+100 courses and a quarter of the others have no prerequisites, the rest one
+to four groups, and a quarter of the groups offer alternatives ("A OR B").
+Half of the level 100 courses start out completed, and every group needs
+GROUP_SHARE of its credits, so the default state is far from meeting the
+requirements at any size. The output only depends on the size and the seed.
+"""
+import argparse
+import csv
+import math
+import os
+import random
+
+LEVELS = [100, 200, 300, 400, 500]
+COURSES_PER_DEPARTMENT = 60
+GROUP_COUNT = 8
+LOCAL_PREREQUISITES = 0.8
+NO_PREREQUISITES = 0.25
+OR_GROUPS = 0.25
+GROUP_SHARE = 0.25
+
+
+def generate_catalog(size, out_dir, seed=0):
+    """Write a catalog of size courses to out_dir; returns the three file paths."""
+    rng = random.Random(seed)
+    departments = max(1, size // COURSES_PER_DEPARTMENT)
+    groups = [f"Group {g + 1}" for g in range(GROUP_COUNT)]
+
+    # Course numbers by department and level, prerequisites first
+    courses = []
+    by_department_level = {}
+    for i in range(size):
+        department = i % departments
+        level = LEVELS[min(len(LEVELS) - 1, i * len(LEVELS) // size)]
+        key = (department, level)
+        number = f"D{department:05d} {level + len(by_department_level.get(key, []))}"
+        by_department_level.setdefault(key, []).append(number)
+        courses.append((number, department, level))
+
+    os.makedirs(out_dir, exist_ok=True)
+    classes_file = os.path.join(out_dir, "classes.csv")
+    groups_file = os.path.join(out_dir, "groups.csv")
+    prereqs_file = os.path.join(out_dir, "prereqs.tsv")
+
+    group_totals = {group: 0 for group in groups}
+    with open(classes_file, "w", newline="", encoding="utf-8") as f:
+        writer = csv.writer(f)
+        writer.writerow(["Class Number:", "Class Name:", "Completed:", "Group:", "Credits:"])
+        for number, department, level in courses:
+            group = groups[(department + level // 100) % GROUP_COUNT]
+            credits = rng.choice([1, 3, 3, 4, 4, 4])
+            group_totals[group] += credits
+            completed = "TRUE" if level == 100 and rng.random() < 0.5 else "FALSE"
+            writer.writerow([number, f"COURSE {number}", completed, group, credits])
+
+    with open(groups_file, "w", newline="", encoding="utf-8") as f:
+        writer = csv.writer(f)
+        writer.writerow(["Group:", "Credits Needed:"])
+        for group in groups:
+            writer.writerow([group, math.ceil(GROUP_SHARE * group_totals[group])])
+
+    with open(prereqs_file, "w", newline="", encoding="utf-8") as f:
+        f.write("Class Number:\tPrerequisites:\n")
+        for number, department, level in courses:
+            lower = [candidate_level for candidate_level in LEVELS if candidate_level < level]
+            if not lower or rng.random() < NO_PREREQUISITES:
+                f.write(f"{number}\t\n")
+                continue
+            prereq_groups = []
+            for _ in range(rng.choice([1, 1, 2, 2, 3, 4])):
+                alternatives = 2 + (rng.random() < 0.3) if rng.random() < OR_GROUPS else 1
+                members = []
+                for _ in range(alternatives):
+                    source = department if rng.random() < LOCAL_PREREQUISITES else rng.randrange(departments)
+                    pool = by_department_level.get((source, rng.choice(lower)))
+                    if pool:
+                        members.append(rng.choice(pool))
+                members = list(dict.fromkeys(members))
+                if members:
+                    prereq_groups.append(" OR ".join(members))
+            f.write(f"{number}\t{', '.join(prereq_groups)}\n")
+
+    return classes_file, groups_file, prereqs_file
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Write a synthetic course catalog")
+    parser.add_argument("size", type=int, help="number of courses")
+    parser.add_argument("out_dir", help="directory for classes.csv, groups.csv and prereqs.tsv")
+    parser.add_argument("--seed", type=int, default=0)
+    args = parser.parse_args()
+    for file_path in generate_catalog(args.size, args.out_dir, args.seed):
+        print(file_path)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,222 @@
+"""Progress reports of many students from a transcripts file.
+
+    python transcripts.py transcripts.csv progress.csv --workers 8
+    python transcripts.py transcripts.csv progress.parquet --programs programs.json --program ce
+
+The transcripts file has one row per student with the columns Student ID:
+and Courses:, the completed course numbers separated by semicolons. It is
+streamed in chunks of --chunk-rows students; every chunk is turned into
+completion bitmasks and evaluated by whatif.evaluate in a pool of worker
+processes, each of which loads the catalog (through its snapshot) and maps
+course numbers to indices once. Chunks are written in input order as they
+finish, with at most two per worker in flight, so memory stays bounded for
+any number of students.
+
+The output has one row per student with the number of completed catalog
+courses, the courses it can take next, completed and remaining credits per
+group of groups.csv and the course numbers that are not in the catalog. It
+is written as CSV, or as Parquet (needs pyarrow) when the output ends in
+.parquet or with --format parquet.
+"""
+import argparse
+from collections import deque
+from concurrent.futures import ProcessPoolExecutor
+import csv
+import os
+import sys
+import time
+
+import whatif
+from catalogs import DEFAULT_PROGRAM, default_programs, load_manifest
+from eligibility import mask_from_indices
+
+COLUMNS = ["Student ID:", "Courses:"]
+
+_catalog = None
+
+
+def load_model(catalog_files, snapshot_path):
+    """(GraphModel, group colors, group credits) of a program's catalog files."""
+    import main
+
+    courses, group_colors, group_credits = main.load_program_catalog(catalog_files, snapshot_path)
+    return main.GraphModel(courses, group_colors), group_colors, group_credits
+
+
+def _init_worker(catalog_files, snapshot_path):
+    global _catalog
+    _catalog = load_model(catalog_files, snapshot_path)
+
+
+def completion_mask(model, course_list):
+    """(completion bitmask, unknown course numbers) of a semicolon-separated course list."""
+    numbers = [number.strip() for number in course_list.split(";") if number.strip()]
+    node_index = model.node_index
+    mask = mask_from_indices((node_index[n] for n in numbers if n in node_index), len(model.nodes))
+    return mask, [n for n in numbers if n not in node_index]
+
+
+def progress_rows(model, group_credits, students):
+    """Output rows of a chunk of (student id, courses) pairs."""
+    completed = []
+    unknown = []
+    for _, course_list in students:
+        mask, missing = completion_mask(model, course_list)
+        completed.append(mask)
+        unknown.append(";".join(missing))
+
+    rows = []
+    results = whatif.evaluate(model, group_credits, completed)
+    for (student, _), mask, result, missing in zip(students, completed, results, unknown):
+        row = [student, bin(mask).count("1"), ";".join(result["eligible"])]
+        for group in group_credits:
+            row.append(result["group_completed_credits"].get(group, 0))
+            row.append(result["remaining_credits"][group])
+        row.append(sum(result["remaining_credits"].values()))
+        row.append(missing)
+        rows.append(row)
+    return rows
+
+
+def _run_chunk(students):
+    model, _, group_credits = _catalog
+    return progress_rows(model, group_credits, students)
+
+
+def header(group_credits):
+    columns = ["Student ID:", "Completed Courses:", "Eligible:"]
+    for group in group_credits:
+        columns += [f"{group} Completed:", f"{group} Remaining:"]
+    return columns + ["Remaining Credits:", "Unknown Courses:"]
+
+
+def read_chunks(file_path, chunk_rows, delimiter=",", engine="csv"):
+    from main import read_rows
+
+    chunk = []
+    for student, course_list in read_rows(file_path, COLUMNS, delimiter, engine):
+        chunk.append((student, course_list))
+        if len(chunk) == chunk_rows:
+            yield chunk
+            chunk = []
+    if chunk:
+        yield chunk
+
+
+class CsvOutput:
+    def __init__(self, path, columns):
+        self.file = open(path, "w", newline="", encoding="utf-8")
+        self.writer = csv.writer(self.file)
+        self.writer.writerow(columns)
+
+    def write(self, rows):
+        self.writer.writerows(rows)
+
+    def close(self):
+        self.file.close()
+
+
+class ParquetOutput:
+    def __init__(self, path, columns):
+        import pyarrow as pa
+        import pyarrow.parquet as pq
+
+        self.pa = pa
+        self.columns = columns
+        # Student, course count, eligible, the group credits, remaining credits, unknown courses
+        types = [pa.string(), pa.int32(), pa.string()] + [pa.int64()] * (len(columns) - 4) + [pa.string()]
+        self.schema = pa.schema(list(zip(columns, types)))
+        self.writer = pq.ParquetWriter(path, self.schema)
+
+    def write(self, rows):
+        table = self.pa.Table.from_arrays(
+            [self.pa.array(values, type) for values, type in zip(zip(*rows), self.schema.types)], schema=self.schema
+        )
+        self.writer.write_table(table)
+
+    def close(self):
+        self.writer.close()
+
+
+def select_program(args):
+    """The Program of --programs and --program, and its snapshot path (None with --no-snapshot).
+
+    A program read from a data source is synced first, which rewrites the
+    snapshot its catalog is then loaded from.
+    """
+    if args.programs:
+        programs = {program.id: program for program in load_manifest(args.programs)}
+        if args.program not in programs:
+            raise SystemExit(f"unknown program {args.program!r}; the manifest has {', '.join(programs)}")
+        program = programs[args.program]
+    else:
+        program = default_programs()[0]
+    if program.source is not None:
+        import main
+        from sources import SourceSync
+
+        sync = SourceSync(program.source, program.cache_file("source.json"))
+        sync.pull()
+        main.load_source_catalog(sync, program.cache_file("catalog.snapshot"))
+        return program, program.cache_file("catalog.snapshot")
+    return program, None if args.no_snapshot else program.cache_file("catalog.snapshot")
+
+
+def run(args):
+    """Write the progress of every student; returns the number of students."""
+    program, snapshot_path = select_program(args)
+
+    # Loading here first also (re)writes the snapshot the workers load
+    model, _, group_credits = load_model(program.catalog_files, snapshot_path)
+    output_format = args.format or ("parquet" if args.output.endswith(".parquet") else "csv")
+    output = (ParquetOutput if output_format == "parquet" else CsvOutput)(args.output, header(group_credits))
+
+    start = time.perf_counter()
+    students = 0
+    chunks = read_chunks(args.transcripts, args.chunk_rows, args.delimiter, args.loader)
+    try:
+        if args.workers <= 0:
+            for chunk in chunks:
+                output.write(progress_rows(model, group_credits, chunk))
+                students += len(chunk)
+        else:
+            with ProcessPoolExecutor(
+                args.workers, initializer=_init_worker, initargs=(program.catalog_files, snapshot_path)
+            ) as pool:
+                pending = deque()
+                for chunk in chunks:
+                    pending.append((len(chunk), pool.submit(_run_chunk, chunk)))
+                    while len(pending) >= 2 * args.workers:
+                        count, future = pending.popleft()
+                        output.write(future.result())
+                        students += count
+                while pending:
+                    count, future = pending.popleft()
+                    output.write(future.result())
+                    students += count
+    finally:
+        output.close()
+    seconds = time.perf_counter() - start
+    print(f"{students} students in {seconds:.1f} s ({students / max(seconds, 1e-9):.0f}/s)", file=sys.stderr)
+    return students
+
+
+def parse_args(argv=None):
+    parser = argparse.ArgumentParser(description="Compute the progress of every student in a transcripts file")
+    parser.add_argument("transcripts", help="CSV with Student ID: and Courses: (semicolon-separated) columns")
+    parser.add_argument("output", help="progress report, CSV or .parquet")
+    parser.add_argument("--programs", help="programs manifest (JSON); the catalog of --program is used")
+    parser.add_argument("--program", default=DEFAULT_PROGRAM, help="program id in the manifest")
+    parser.add_argument("--workers", type=int, default=os.cpu_count() or 1,
+                        help="worker processes (0 computes everything in this process)")
+    parser.add_argument("--chunk-rows", type=int, default=4096, help="students per job of a worker")
+    parser.add_argument("--format", choices=["csv", "parquet"], help="output format (default: by extension)")
+    parser.add_argument("--delimiter", default=",", help="field delimiter of the transcripts file")
+    parser.add_argument("--loader", choices=["csv", "pyarrow"], default="csv",
+                        help="CSV reader for the transcripts file")
+    parser.add_argument("--no-snapshot", action="store_true", help="parse the catalog text files")
+    return parser.parse_args(argv)
+
+
+if __name__ == "__main__":
+    run(parse_args())
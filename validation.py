@@ -0,0 +1,157 @@
+"""Consistency checks of a parsed catalog, run once at load.
+
+check_catalog looks at every course and prerequisite once:
+
+- prerequisites that are not in classes.csv (dangling) are dropped, along
+  with the groups they leave empty, so everything built from the courses
+  can index them without checking;
+- groups of classes.csv missing from groups.csv are reported, as are
+  course numbers listed twice in classes.csv (the last row wins; the
+  snapshot keeps the report, since it only holds the last row);
+- cycles among the prerequisites are found with Tarjan's strongly
+  connected components algorithm. A cycle makes its courses impossible to
+  take and would break every topological order, so it is an error; the
+  layout, reachability index and planner assume a DAG.
+
+Everything but cycles is a warning unless strict is set.
+"""
+
+
+class CatalogError(ValueError):
+    """Raised when a catalog cannot be used, e.g. its prerequisites form a cycle."""
+
+
+class CatalogReport:
+    """The problems check_catalog found in one catalog."""
+
+    EXAMPLES = 10
+
+    def __init__(self, duplicates, dangling, missing_groups, cycles):
+        self.duplicates = duplicates
+        self.dangling = dangling
+        self.missing_groups = missing_groups
+        self.cycles = cycles
+
+    def __bool__(self):
+        return bool(self.duplicates or self.dangling or self.missing_groups or self.cycles)
+
+    def lines(self):
+        """One line per kind of problem, with the first few examples."""
+        def examples(items):
+            text = ", ".join(items[:self.EXAMPLES])
+            return text + (f" and {len(items) - self.EXAMPLES} more" if len(items) > self.EXAMPLES else "")
+
+        lines = []
+        if self.cycles:
+            lines.append(f"{len(self.cycles)} prerequisite cycle(s) among: "
+                         + examples(["{" + ", ".join(cycle) + "}" for cycle in self.cycles]))
+        if self.dangling:
+            lines.append(f"{len(self.dangling)} prerequisite(s) not in classes.csv, ignored: "
+                         + examples([f"{prereq} (of {course})" for course, prereq in self.dangling]))
+        if self.missing_groups:
+            lines.append(f"{len(self.missing_groups)} group(s) missing from groups.csv, needing 0 credits: "
+                         + examples(self.missing_groups))
+        if self.duplicates:
+            lines.append(f"{len(self.duplicates)} course number(s) listed more than once, the last row is used: "
+                         + examples(self.duplicates))
+        return lines
+
+    def __str__(self):
+        return "; ".join(self.lines()) or "no problems"
+
+    def enforce(self, strict=False):
+        """Raise CatalogError on a cycle, or on any problem when strict."""
+        if self.cycles or (strict and self):
+            raise CatalogError(str(self))
+
+
+def strongly_connected_components(adjacency):
+    """Tarjan's algorithm over node indices, without recursion.
+
+    Returns the components as lists of node indices, each component after
+    all components it has edges to.
+    """
+    size = len(adjacency)
+    index = [-1] * size
+    lowlink = [0] * size
+    on_stack = [False] * size
+    stack = []
+    components = []
+    counter = 0
+    for root in range(size):
+        if index[root] != -1:
+            continue
+        # Frames of (node, position in its adjacency list)
+        work = [(root, 0)]
+        index[root] = lowlink[root] = counter
+        counter += 1
+        stack.append(root)
+        on_stack[root] = True
+        while work:
+            node, position = work[-1]
+            neighbors = adjacency[node]
+            if position < len(neighbors):
+                work[-1] = (node, position + 1)
+                neighbor = neighbors[position]
+                if index[neighbor] == -1:
+                    index[neighbor] = lowlink[neighbor] = counter
+                    counter += 1
+                    stack.append(neighbor)
+                    on_stack[neighbor] = True
+                    work.append((neighbor, 0))
+                elif on_stack[neighbor]:
+                    lowlink[node] = min(lowlink[node], index[neighbor])
+                continue
+            work.pop()
+            if work:
+                parent = work[-1][0]
+                lowlink[parent] = min(lowlink[parent], lowlink[node])
+            if lowlink[node] == index[node]:
+                component = []
+                while True:
+                    member = stack.pop()
+                    on_stack[member] = False
+                    component.append(member)
+                    if member == node:
+                        break
+                components.append(component)
+    return components
+
+
+def check_catalog(courses, group_credits, duplicates=(), strict=False):
+    """Check a parsed catalog and drop its dangling prerequisites in place.
+
+    courses are mutable Course objects by course number and duplicates the
+    course numbers parse_classes saw more than once. Returns the
+    CatalogReport; raises CatalogError on a cycle, or on any problem when
+    strict.
+    """
+    dangling = []
+    for number, course in courses.items():
+        kept_groups = []
+        for prereq_group in course.prerequisites:
+            kept = [prereq for prereq in prereq_group if prereq in courses]
+            dangling.extend((number, prereq) for prereq in prereq_group if prereq not in courses)
+            if kept:
+                kept_groups.append(kept)
+        course.prerequisites = kept_groups
+
+    missing_groups = sorted({course.group for course in courses.values()} - set(group_credits))
+
+    # Edges from every course to its prerequisites; a course listing itself
+    # is a cycle of one
+    numbers = list(courses)
+    position = {number: i for i, number in enumerate(numbers)}
+    adjacency = [
+        [position[prereq] for prereq_group in courses[number].prerequisites for prereq in prereq_group]
+        for number in numbers
+    ]
+    cycles = [
+        sorted(numbers[i] for i in component)
+        for component in strongly_connected_components(adjacency)
+        if len(component) > 1 or component[0] in adjacency[component[0]]
+    ]
+
+    report = CatalogReport(sorted(set(duplicates)), dangling, missing_groups, cycles)
+    report.enforce(strict)
+    return report
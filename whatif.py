@@ -0,0 +1,141 @@
+"""Batch "what-if" evaluation of many completion states at once.
+
+    POST /api/whatif  (under each program's path with a manifest)
+    {"states": [["EECS 280", "MATH 115"], "1f3", ...],
+     "assume": ["MATH 216"], "courses": ["EECS 281"]}
+
+Each state is a list of completed course numbers or a completion bitmask in
+the hex form of the completion-state store. Every course in assume is added
+to every state, and courses limits the reported eligible courses. The
+answer has one row per state with the courses it can take next (eligible
+and not completed), its completed credits per group and the credits still
+needed per group.
+
+Rows are evaluated together: the state matrix is transposed so that every
+course holds one integer with bit r set when row r completed it, and a
+prerequisite group is then met for all rows by one OR over its members and
+one AND per group, over the same compiled groups as PrerequisiteEngine.
+Credits are counted per row with one popcount per group and credit value.
+Large batches are split into chunks that run on the analytics process pool.
+"""
+from eligibility import mask_from_indices
+
+# Rows evaluated by one job of the analytics pool; smaller batches stay inline
+CHUNK_ROWS = 512
+MAX_ROWS = 100000
+
+
+def _transpose(masks, size):
+    """Bit matrix transpose: bit i of masks[r] becomes bit r of the result's [i]."""
+    positions = [[] for _ in range(size)]
+    for r, mask in enumerate(masks):
+        flags = format(mask, "b")[::-1]
+        i = flags.find("1")
+        while i >= 0:
+            positions[i].append(r)
+            i = flags.find("1", i + 1)
+    return [mask_from_indices(rows, len(masks)) for rows in positions]
+
+
+def credit_masks(model):
+    """(group, credits, bitmask of the group's courses worth that many credits)."""
+    masks = {}
+    for i, (group, credits) in enumerate(zip(model.node_group, model.node_credits)):
+        masks[group, credits] = masks.get((group, credits), 0) | 1 << i
+    return [(group, credits, mask) for (group, credits), mask in masks.items()]
+
+
+def evaluate(model, group_credits, completed, courses=None):
+    """Eligibility and credits of a list of completion bitmasks, one dict per row.
+
+    courses is a bitmask limiting the reported eligible courses.
+    """
+    size = len(model.nodes)
+    rows = len(completed)
+    all_rows = (1 << rows) - 1
+
+    # Completed rows of every course, then eligible rows of every course
+    columns = _transpose(completed, size)
+    eligible_columns = []
+    for groups in model.engine.alternatives:
+        met = all_rows
+        for members in groups:
+            any_member = 0
+            for member in members:
+                any_member |= columns[member]
+            met &= any_member
+            if not met:
+                break
+        eligible_columns.append(met)
+    eligible = _transpose(eligible_columns, rows)
+
+    report = courses if courses is not None else (1 << size) - 1
+    credits = credit_masks(model)
+    results = []
+    for r, mask in enumerate(completed):
+        next_courses = eligible[r] & ~mask & report
+        group_completed = {group: 0 for group in model.groups}
+        for group, value, group_mask in credits:
+            group_completed[group] += value * bin(mask & group_mask).count("1")
+        results.append({
+            "eligible": [model.nodes[i] for i, flag in enumerate(format(next_courses, "b")[::-1]) if flag == "1"],
+            "group_completed_credits": group_completed,
+            "remaining_credits": {
+                group: max(0, needed - group_completed.get(group, 0)) for group, needed in group_credits.items()
+            },
+        })
+    return results
+
+
+def parse_request(model, data):
+    """(completion bitmasks, report bitmask or None) of a request body; raises ValueError."""
+    if not isinstance(data, dict) or not isinstance(data.get("states"), list):
+        raise ValueError('expected a JSON object with a "states" list')
+    if len(data["states"]) > MAX_ROWS:
+        raise ValueError(f"at most {MAX_ROWS} states per request")
+    size = len(model.nodes)
+    unknown = set()
+
+    def course_mask(numbers):
+        if not isinstance(numbers, list):
+            raise ValueError("courses must be given as a list of course numbers")
+        # Anything but a string (a list, an object, a number) is no course number
+        numbers = [number if isinstance(number, str) else repr(number) for number in numbers]
+        unknown.update(number for number in numbers if number not in model.node_index)
+        return mask_from_indices((model.node_index[n] for n in numbers if n in model.node_index), size)
+
+    assume = course_mask(data.get("assume", []))
+    completed = []
+    for state in data["states"]:
+        if isinstance(state, str):
+            try:
+                mask = int(state, 16)
+            except ValueError:
+                raise ValueError(f"not a completion bitmask: {state!r}") from None
+            if mask >> size:
+                raise ValueError(f"completion bitmask {state!r} has more than {size} courses")
+        else:
+            mask = course_mask(state)
+        completed.append(mask | assume)
+    courses = course_mask(data["courses"]) if "courses" in data else None
+    if unknown:
+        raise ValueError("unknown courses: " + ", ".join(sorted(map(str, unknown))))
+    return completed, courses
+
+
+def install(server, path, endpoint, live, analytics):
+    """Serve the batch API of one program's LiveCatalog at path."""
+    import flask
+
+    @server.route(path, methods=["POST"], endpoint=endpoint)
+    def whatif():
+        catalog = live.get()
+        try:
+            completed, courses = parse_request(catalog.model, flask.request.get_json(silent=True))
+        except ValueError as error:
+            return flask.jsonify({"error": str(error)}), 400
+        version, rows = analytics.batch(catalog.program.id, completed, courses)
+        if version != catalog.version:
+            # The catalog was reloaded between parsing and evaluating
+            return flask.jsonify({"error": "the catalog changed, please retry"}), 409
+        return flask.jsonify({"version": version, "rows": rows})
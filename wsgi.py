@@ -0,0 +1,30 @@
+"""WSGI entry point for production servers.
+
+    gunicorn -c gunicorn.conf.py wsgi:application
+
+The catalog is loaded when this module is imported. With preload_app (see
+gunicorn.conf.py) that happens once in the master before the workers fork,
+so they share the parsed catalog and graph model. Command line options of
+main.py can be passed through the COURSE_CHART_ARGS environment variable,
+e.g. COURSE_CHART_ARGS="--layout layered --columnar" or
+COURSE_CHART_ARGS="--programs programs.json" to host several programs.
+Response compression is on by default here.
+
+Only the catalogs and graph models are shared. Each worker has its own
+analytics pools and results, figure cache (--figure-cache-mb each), catalog
+watcher and /metrics, so scrape the workers one by one or aggregate in
+Prometheus. The what-if batch pool of each worker gets the worker's share
+of the CPUs, at least one process, unless --batch-workers says otherwise.
+Data sources are pulled by one worker at a time (see hot_reload.py).
+"""
+import os
+import shlex
+
+from main import create_app, parse_args
+
+batch_workers = max(1, (os.cpu_count() or 1) // int(os.environ.get("COURSE_CHART_WORKERS", 1)))
+args = parse_args(
+    ["--compress", "--batch-workers", str(batch_workers)] + shlex.split(os.environ.get("COURSE_CHART_ARGS", ""))
+)
+app = create_app(args, precompute=False)
+application = app.server  # shared by every program's app